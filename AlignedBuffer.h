@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	AlignedBuffer.h
+//	------------------------
+//	
+//	A single cache-line aligned heap block of plain values,
+//	used for per-clip frame data so that a whole clip lives
+//	in one contiguous allocation that SIMD code can load
+//	from directly
+//	
+///////////////////////////////////////////////////
+
+#ifndef _ALIGNEDBUFFER_H
+#define _ALIGNEDBUFFER_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+template <typename T>
+class AlignedBuffer
+	{ // class AlignedBuffer
+	static_assert(std::is_trivially_copyable<T>::value, "AlignedBuffer holds plain values only");
+
+	public:
+	// every buffer starts on a cache line (which also suits AVX loads)
+	static const size_t alignment = 64;
+
+	// constructor will initialise to an empty buffer
+	AlignedBuffer() : data(nullptr), size(0) {}
+
+	// destructor frees the block
+	~AlignedBuffer() { Clear(); }
+
+	// a buffer owns its block, so it may be moved but not copied
+	AlignedBuffer(const AlignedBuffer &) = delete;
+	AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+	AlignedBuffer(AlignedBuffer &&other) : data(other.data), size(other.size)
+		{ // move constructor
+		other.data = nullptr;
+		other.size = 0;
+		} // move constructor
+	AlignedBuffer &operator=(AlignedBuffer &&other)
+		{ // move assignment
+		if (this != &other)
+			{ // different buffer
+			Clear();
+			data = other.data;
+			size = other.size;
+			other.data = nullptr;
+			other.size = 0;
+			} // different buffer
+		return *this;
+		} // move assignment
+
+	// change the number of elements, keeping the existing ones and zeroing any new ones
+	void Resize(size_t count)
+		{ // Resize()
+		if (count == size)
+			return;
+		T *block = nullptr;
+		if (count > 0)
+			{ // allocate the new block
+			block = (T *) ::operator new(count * sizeof(T), std::align_val_t(alignment));
+			size_t kept = count < size ? count : size;
+			if (kept > 0)
+				memcpy((void *) block, (const void *) data, kept * sizeof(T));
+			memset((void *) (block + kept), 0, (count - kept) * sizeof(T));
+			} // allocate the new block
+		Clear();
+		data = block;
+		size = count;
+		} // Resize()
+
+	// free the block
+	void Clear()
+		{ // Clear()
+		if (data != nullptr)
+			::operator delete((void *) data, std::align_val_t(alignment));
+		data = nullptr;
+		size = 0;
+		} // Clear()
+
+	// access to the block
+	T *Data() { return data; }
+	const T *Data() const { return data; }
+	size_t Size() const { return size; }
+	bool Empty() const { return size == 0; }
+	T &operator [](size_t index) { return data[index]; }
+	const T &operator [](size_t index) const { return data[index]; }
+
+	private:
+	// the block and the number of elements in it
+	T *data;
+	size_t size;
+	}; // class AlignedBuffer
+
+#endif
@@ -7,28 +7,66 @@ QT = core gui widgets
 
 QT+=opengl
 LIBS += -lGLU
+CONFIG += c++17 thread
 
 
 HEADERS = \
+   $$PWD/AlignedBuffer.h \
    $$PWD/AnimationCycleWidget.h \
+   $$PWD/AnimationDatabase.h \
+   $$PWD/AnimationTools.h \
+   $$PWD/AssetLoader.h \
    $$PWD/BVHData.h \
+   $$PWD/BlendTree.h \
+   $$PWD/BVHStream.h \
+   $$PWD/BVHTokenizer.h \
    $$PWD/Cartesian3.h \
+   $$PWD/CompressedClip.h \
+   $$PWD/Crowd.h \
+   $$PWD/GaitTrack.h \
    $$PWD/Homogeneous4.h \
    $$PWD/HomogeneousFaceSurface.h \
+   $$PWD/Inertializer.h \
+   $$PWD/MappedFile.h \
    $$PWD/Matrix4.h \
+   $$PWD/MotionMatching.h \
+   $$PWD/Pose.h \
+   $$PWD/PoseCache.h \
+   $$PWD/PoseKernels.h \
+   $$PWD/Quaternion.h \
    $$PWD/SceneModel.h \
-   $$PWD/Terrain.h
+   $$PWD/Skeleton.h \
+   $$PWD/Terrain.h \
+   $$PWD/TransitionTable.h
 
 SOURCES = \
    $$PWD/AnimationCycleWidget.cpp \
+   $$PWD/AnimationDatabase.cpp \
+   $$PWD/AnimationTools.cpp \
+   $$PWD/AssetLoader.cpp \
    $$PWD/BVHData.cpp \
+   $$PWD/BlendTree.cpp \
+   $$PWD/BVHStream.cpp \
+   $$PWD/BVHTokenizer.cpp \
    $$PWD/Cartesian3.cpp \
+   $$PWD/CompressedClip.cpp \
+   $$PWD/Crowd.cpp \
+   $$PWD/GaitTrack.cpp \
    $$PWD/Homogeneous4.cpp \
    $$PWD/HomogeneousFaceSurface.cpp \
+   $$PWD/Inertializer.cpp \
    $$PWD/main.cpp \
+   $$PWD/MappedFile.cpp \
    $$PWD/Matrix4.cpp \
+   $$PWD/MotionMatching.cpp \
+   $$PWD/Pose.cpp \
+   $$PWD/PoseCache.cpp \
+   $$PWD/PoseKernels.cpp \
+   $$PWD/Quaternion.cpp \
    $$PWD/SceneModel.cpp \
-   $$PWD/Terrain.cpp
+   $$PWD/Skeleton.cpp \
+   $$PWD/Terrain.cpp \
+   $$PWD/TransitionTable.cpp
 
 INCLUDEPATH = \
     $$PWD/.
@@ -23,8 +23,17 @@
 
 #endif
 
+#include <QGuiApplication>
+#include <QScreen>
+
+#include <algorithm>
+
 #include "AnimationCycleWidget.h"
 
+// the longest step the scene is advanced by, so that a stall (e.g. dragging the
+// window) does not throw the character across the terrain
+static const float maxFrameSeconds = 0.1f;
+
 // constructor
 AnimationCycleWidget::AnimationCycleWidget(QWidget *parent, SceneModel *TheScene)
 	: _GEOMETRIC_WIDGET_PARENT_CLASS(parent),
@@ -34,8 +43,12 @@ AnimationCycleWidget::AnimationCycleWidget(QWidget *parent, SceneModel *TheScene
 	animationTimer = new QTimer(this);
 	// connect it to the desired slot
 	connect(animationTimer, SIGNAL(timeout()), this, SLOT(nextFrame()));
-	// set the timer to fire 24 times a second
-	animationTimer->start((double)41.6667);
+	// the scene is advanced by the time that has passed rather than by ticks, so the
+	// timer fires at the display's refresh rate (60 Hz if it cannot be found)
+	QScreen *screen = QGuiApplication::primaryScreen();
+	double refreshRate = screen != nullptr && screen->refreshRate() > 0.0 ? screen->refreshRate() : 60.0;
+	animationClock.start();
+	animationTimer->start((int) (1000.0 / refreshRate));
 	} // constructor
 
 // destructor
@@ -120,6 +133,21 @@ void AnimationCycleWidget::keyPressEvent(QKeyEvent *event)
 		case Qt::Key_P:
 			theScene->EventCharacterReset();
 			break;
+
+		// switches between the character and a crowd
+		case Qt::Key_C:
+			theScene->EventToggleCrowd();
+			break;
+
+		// switches between crossfaded and inertialized transitions
+		case Qt::Key_I:
+			theScene->EventToggleTransitions();
+			break;
+
+		// switches motion matching on and off
+		case Qt::Key_M:
+			theScene->EventToggleMotionMatching();
+			break;
 			
 		// keys for engaging character animation
 		case Qt::Key_Up:
@@ -162,8 +190,9 @@ void AnimationCycleWidget::keyReleaseEvent(QKeyEvent* event)
 
 void AnimationCycleWidget::nextFrame()
 	{ // nextFrame()
-	// each time this gets called, we will update the scene
-	theScene->Update();
+	// each time this gets called, we will update the scene by the time since the last
+	float seconds = std::min(animationClock.restart() / 1000.0f, maxFrameSeconds);
+	theScene->Update(seconds);
 
 	// now force an update
 	update();
@@ -27,6 +27,7 @@
 #define _GL_WIDGET_UPDATE_CALL update
 #endif
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QMouseEvent>
 
 #include "SceneModel.h"
@@ -41,6 +42,9 @@ class AnimationCycleWidget : public _GEOMETRIC_WIDGET_PARENT_CLASS
 	// a timer for animation
 	QTimer *animationTimer;
 
+	// the time since the last frame, which the scene is advanced by
+	QElapsedTimer animationClock;
+
 	// constructor
 	AnimationCycleWidget(QWidget *parent, SceneModel *TheScene);
 	
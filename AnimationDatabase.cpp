@@ -0,0 +1,333 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	AnimationDatabase.cpp
+//	------------------------
+//	
+//	A packed binary file holding one shared skeleton and
+//	any number of clips, compiled offline from bvh files.
+//	At runtime the file is memory-mapped and clips point
+//	straight at its pages.
+//	
+///////////////////////////////////////////////////
+
+#include "AnimationDatabase.h"
+
+#include <cstring>
+#include <fstream>
+
+// the rotation tracks are read in place as Cartesian3 triples
+static_assert(sizeof(Cartesian3) == 3 * sizeof(float), "Cartesian3 must be three packed floats");
+
+// magic number at the start of every database
+static const char databaseMagic[8] = { 'A', 'N', 'I', 'M', 'D', 'B', 0, 0 };
+
+// channel ids run from Xposition (0) to Zrotation (5), as in BVHData::BVH_CHANNEL
+static const uint8_t channelIds = 6;
+
+// round a byte offset up to the section alignment
+static uint64_t AlignSection(uint64_t offset)
+	{ // AlignSection()
+	return (offset + 15) & ~(uint64_t) 15;
+	} // AlignSection()
+
+// write zero bytes until the stream reaches a given offset
+static void PadTo(std::ofstream &outFile, uint64_t offset)
+	{ // PadTo()
+	static const char zeros[16] = { 0 };
+	uint64_t position = (uint64_t) outFile.tellp();
+	if (position < offset)
+		outFile.write(zeros, offset - position);
+	} // PadTo()
+
+// whether a section of a given size at a given offset lies inside the file (written
+// so that no sum can wrap round)
+static bool SectionFits(uint64_t offset, uint64_t bytes, uint64_t fileSize)
+	{ // SectionFits()
+	return offset <= fileSize && bytes <= fileSize - offset;
+	} // SectionFits()
+
+// whether a name starts inside the name section and is terminated before its end
+static bool NameFits(const char *names, uint64_t nameBytes, uint32_t nameOffset)
+	{ // NameFits()
+	return nameOffset < nameBytes && memchr(names + nameOffset, 0, nameBytes - nameOffset) != nullptr;
+	} // NameFits()
+
+// the name a bvh file is stored under: the file name without directory or extension
+std::string AnimationDatabase::ClipName(const std::string &fileName)
+	{ // ClipName()
+	size_t start = fileName.find_last_of("/\\");
+	start = (start == std::string::npos) ? 0 : start + 1;
+	size_t stop = fileName.find_last_of('.');
+	if (stop == std::string::npos || stop < start)
+		stop = fileName.size();
+	return fileName.substr(start, stop - start);
+	} // ClipName()
+
+// compile a set of bvh files into a database file
+bool AnimationDatabase::Compile(const std::vector<std::string> &bvhFiles, const char *databaseName, std::string &error)
+	{ // Compile()
+	if (bvhFiles.empty())
+		{ // nothing to do
+		error = "no clips given";
+		return false;
+		} // nothing to do
+
+	// parse every clip first, so a bad file leaves no half-written database
+	std::vector<BVHData> sources(bvhFiles.size());
+	for (size_t clip = 0; clip < bvhFiles.size(); clip++)
+		{ // per clip
+		if (!sources[clip].ReadFileBVH(bvhFiles[clip].c_str()))
+			{ // unreadable
+			error = "unable to read " + bvhFiles[clip];
+			return false;
+			} // unreadable
+		} // per clip
+
+	// the first clip defines the skeleton, and the rest must agree with it
+	const Skeleton &skeleton = sources[0].skeleton;
+	size_t jointCount = skeleton.JointCount();
+	for (size_t clip = 1; clip < sources.size(); clip++)
+		if (!sources[clip].skeleton.SameLayout(skeleton))
+			{ // different skeleton
+			error = bvhFiles[clip] + " does not share the skeleton of " + bvhFiles[0];
+			return false;
+			} // different skeleton
+
+	// build the skeleton records, collecting names as we go
+	std::string nameBlock;
+	std::vector<DatabaseJoint> jointRecords(jointCount);
+	for (size_t joint = 0; joint < jointCount; joint++)
+		{ // per joint
+		DatabaseJoint &record = jointRecords[joint];
+		memset(&record, 0, sizeof(record));
+		record.parent = skeleton.parent[joint];
+		for (int axis = 0; axis < 3; axis++)
+			record.offset[axis] = skeleton.offset[joint][axis];
+		record.nameOffset = (uint32_t) nameBlock.size();
+		nameBlock += skeleton.Name(joint);
+		nameBlock.push_back('\0');
+		if (skeleton.channelCount[joint] > (int) sizeof(record.channels))
+			{ // too many channels
+			error = "joint " + skeleton.Name(joint) + " has too many channels";
+			return false;
+			} // too many channels
+		record.channelCount = (uint32_t) skeleton.channelCount[joint];
+		for (int channel = 0; channel < skeleton.channelCount[joint]; channel++)
+			{ // per channel
+			int id = skeleton.channels[skeleton.firstChannel[joint] + channel];
+			if (id < 0)
+				{ // unknown channel
+				error = "joint " + skeleton.Name(joint) + " has an unknown channel";
+				return false;
+				} // unknown channel
+			record.channels[channel] = (uint8_t) id;
+			} // per channel
+		} // per joint
+
+	// lay out the sections
+	DatabaseHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, databaseMagic, sizeof(databaseMagic));
+	header.version = ANIMATION_DATABASE_VERSION;
+	header.byteOrder = 0x01020304;
+	header.jointCount = (uint32_t) jointCount;
+	header.clipCount = (uint32_t) sources.size();
+	header.skeletonOffset = AlignSection(sizeof(DatabaseHeader));
+	header.clipOffset = AlignSection(header.skeletonOffset + jointCount * sizeof(DatabaseJoint));
+
+	std::vector<DatabaseClip> clipRecords(sources.size());
+	for (size_t clip = 0; clip < sources.size(); clip++)
+		{ // per clip
+		DatabaseClip &record = clipRecords[clip];
+		memset(&record, 0, sizeof(record));
+		record.nameOffset = (uint32_t) nameBlock.size();
+		nameBlock += ClipName(bvhFiles[clip]);
+		nameBlock.push_back('\0');
+		record.frameCount = (uint32_t) sources[clip].frame_count;
+		record.frameTime = sources[clip].frame_time;
+		record.channelCount = (uint32_t) sources[clip].skeleton.ChannelCount();
+		} // per clip
+
+	header.nameOffset = AlignSection(header.clipOffset + sources.size() * sizeof(DatabaseClip));
+	header.nameBytes = nameBlock.size();
+	uint64_t trackOffset = AlignSection(header.nameOffset + header.nameBytes);
+	for (size_t clip = 0; clip < sources.size(); clip++)
+		{ // per clip
+		clipRecords[clip].rotationOffset = trackOffset;
+		trackOffset = AlignSection(trackOffset + (uint64_t) clipRecords[clip].frameCount * jointCount * sizeof(Cartesian3));
+		clipRecords[clip].rootPositionOffset = trackOffset;
+		trackOffset = AlignSection(trackOffset + (uint64_t) clipRecords[clip].frameCount * sizeof(Cartesian3));
+		clipRecords[clip].rootMotionOffset = trackOffset;
+		trackOffset = AlignSection(trackOffset + (uint64_t) clipRecords[clip].frameCount * sizeof(RootMotionDelta));
+		clipRecords[clip].quaternionOffset = trackOffset;
+		trackOffset = AlignSection(trackOffset + (uint64_t) clipRecords[clip].frameCount * jointCount * sizeof(Quaternion));
+		} // per clip
+
+	// and write them out
+	std::ofstream outFile(databaseName, std::ios::binary | std::ios::trunc);
+	if (!outFile.good())
+		{ // cannot write
+		error = std::string("unable to write ") + databaseName;
+		return false;
+		} // cannot write
+	outFile.write((const char *) &header, sizeof(header));
+	PadTo(outFile, header.skeletonOffset);
+	outFile.write((const char *) jointRecords.data(), jointRecords.size() * sizeof(DatabaseJoint));
+	PadTo(outFile, header.clipOffset);
+	outFile.write((const char *) clipRecords.data(), clipRecords.size() * sizeof(DatabaseClip));
+	PadTo(outFile, header.nameOffset);
+	outFile.write(nameBlock.data(), nameBlock.size());
+	for (size_t clip = 0; clip < sources.size(); clip++)
+		{ // per clip
+		PadTo(outFile, clipRecords[clip].rotationOffset);
+		outFile.write((const char *) sources[clip].rotationData.Data(), sources[clip].rotationData.Size() * sizeof(Cartesian3));
+		PadTo(outFile, clipRecords[clip].rootPositionOffset);
+		outFile.write((const char *) sources[clip].rootPositionData.Data(), sources[clip].rootPositionData.Size() * sizeof(Cartesian3));
+		PadTo(outFile, clipRecords[clip].rootMotionOffset);
+		outFile.write((const char *) sources[clip].rootMotionData.Data(), sources[clip].rootMotionData.Size() * sizeof(RootMotionDelta));
+		PadTo(outFile, clipRecords[clip].quaternionOffset);
+		outFile.write((const char *) sources[clip].quaternionData.Data(), sources[clip].quaternionData.Size() * sizeof(Quaternion));
+		} // per clip
+	if (!outFile.good())
+		{ // write failed
+		error = std::string("error writing ") + databaseName;
+		return false;
+		} // write failed
+	return true;
+	} // Compile()
+
+// map a database file, returns true on success
+bool AnimationDatabase::Open(const char *databaseName)
+	{ // Open()
+	Close();
+	if (!file.Open(databaseName))
+		return false;
+
+	// check the header before trusting any offsets
+	const DatabaseHeader *candidate = (const DatabaseHeader *) file.Data();
+	bool valid = file.Size() >= sizeof(DatabaseHeader)
+		&& memcmp(candidate->magic, databaseMagic, sizeof(databaseMagic)) == 0
+		&& candidate->version == ANIMATION_DATABASE_VERSION
+		&& candidate->byteOrder == 0x01020304
+		&& SectionFits(candidate->skeletonOffset, (uint64_t) candidate->jointCount * sizeof(DatabaseJoint), file.Size())
+		&& SectionFits(candidate->clipOffset, (uint64_t) candidate->clipCount * sizeof(DatabaseClip), file.Size())
+		&& SectionFits(candidate->nameOffset, candidate->nameBytes, file.Size());
+	if (valid)
+		{ // check the joints, which BindClip builds a skeleton from
+		const DatabaseJoint *candidateJoints = (const DatabaseJoint *) (file.Data() + candidate->skeletonOffset);
+		const char *candidateNames = file.Data() + candidate->nameOffset;
+		for (uint32_t joint = 0; valid && joint < candidate->jointCount; joint++)
+			{ // per joint
+			const DatabaseJoint &record = candidateJoints[joint];
+			// a parent comes before its children, as the skeleton's joint order needs
+			valid = record.parent >= -1 && record.parent < (int32_t) joint
+				&& NameFits(candidateNames, candidate->nameBytes, record.nameOffset)
+				&& record.channelCount <= sizeof(record.channels);
+			for (uint32_t channel = 0; valid && channel < record.channelCount; channel++)
+				valid = record.channels[channel] < channelIds;
+			} // per joint
+		} // check the joints
+	if (valid)
+		{ // check the clips too
+		const DatabaseClip *candidateClips = (const DatabaseClip *) (file.Data() + candidate->clipOffset);
+		const char *candidateNames = file.Data() + candidate->nameOffset;
+		for (uint32_t clip = 0; valid && clip < candidate->clipCount; clip++)
+			{ // per clip
+			const DatabaseClip &record = candidateClips[clip];
+			valid = NameFits(candidateNames, candidate->nameBytes, record.nameOffset)
+				&& SectionFits(record.rotationOffset, (uint64_t) record.frameCount * candidate->jointCount * sizeof(Cartesian3), file.Size())
+				&& SectionFits(record.rootPositionOffset, (uint64_t) record.frameCount * sizeof(Cartesian3), file.Size())
+				&& SectionFits(record.rootMotionOffset, (uint64_t) record.frameCount * sizeof(RootMotionDelta), file.Size())
+				&& SectionFits(record.quaternionOffset, (uint64_t) record.frameCount * candidate->jointCount * sizeof(Quaternion), file.Size());
+			} // per clip
+		} // check the clips too
+	if (!valid)
+		{ // not a database we can read
+		file.Close();
+		return false;
+		} // not a database we can read
+
+	header = candidate;
+	joints = (const DatabaseJoint *) (file.Data() + header->skeletonOffset);
+	clips = (const DatabaseClip *) (file.Data() + header->clipOffset);
+	names = file.Data() + header->nameOffset;
+	return true;
+	} // Open()
+
+// release the mapping
+void AnimationDatabase::Close()
+	{ // Close()
+	file.Close();
+	header = nullptr;
+	joints = nullptr;
+	clips = nullptr;
+	names = nullptr;
+	} // Close()
+
+// true if a database is mapped
+bool AnimationDatabase::IsOpen() const
+	{ // IsOpen()
+	return header != nullptr;
+	} // IsOpen()
+
+// number of clips in the database
+int AnimationDatabase::ClipCount() const
+	{ // ClipCount()
+	return IsOpen() ? (int) header->clipCount : 0;
+	} // ClipCount()
+
+// name of a clip
+const char *AnimationDatabase::ClipNameAt(int clip) const
+	{ // ClipNameAt()
+	return names + clips[clip].nameOffset;
+	} // ClipNameAt()
+
+// index of the clip with a given name, or -1
+int AnimationDatabase::FindClip(const std::string &clipName) const
+	{ // FindClip()
+	for (int clip = 0; clip < ClipCount(); clip++)
+		if (clipName == ClipNameAt(clip))
+			return clip;
+	return -1;
+	} // FindClip()
+
+// set up a bvh object to play a clip straight from the mapped pages
+bool AnimationDatabase::BindClip(const std::string &clipName, BVHData &clip) const
+	{ // BindClip()
+	int clipIndex = FindClip(clipName);
+	if (clipIndex < 0)
+		return false;
+	const DatabaseClip &record = clips[clipIndex];
+	int jointCount = (int) header->jointCount;
+
+	// rebuild the skeleton
+	clip.skeleton.Clear();
+	for (int joint = 0; joint < jointCount; joint++)
+		{ // per joint
+		clip.skeleton.AddJoint(names + joints[joint].nameOffset, joints[joint].parent);
+		clip.skeleton.offset[joint] = Cartesian3(joints[joint].offset[0], joints[joint].offset[1], joints[joint].offset[2]);
+		for (uint32_t channel = 0; channel < joints[joint].channelCount; channel++)
+			clip.skeleton.AddChannel(joints[joint].channels[channel]);
+		} // per joint
+
+	// and point the frame data at the mapping
+	clip.frame_count = (int) record.frameCount;
+	clip.frame_time = record.frameTime;
+	clip.channelData.Clear();
+	clip.rotationData.Clear();
+	clip.rootPositionData.Clear();
+	clip.rootMotionData.Clear();
+	clip.quaternionData.Clear();
+	clip.motionStream.reset();
+	clip.compressedMotion.reset();
+	clip.rotationTrack = (const Cartesian3 *) (file.Data() + record.rotationOffset);
+	clip.rootPositionTrack = (const Cartesian3 *) (file.Data() + record.rootPositionOffset);
+	clip.rootMotionTrack = (const RootMotionDelta *) (file.Data() + record.rootMotionOffset);
+	clip.quaternionTrack = (const Quaternion *) (file.Data() + record.quaternionOffset);
+	// anything worked out from the frames the clip held before goes with them
+	clip.poseCache.reset();
+	clip.gait.reset();
+	clip.NewSerial();
+	return true;
+	} // BindClip()
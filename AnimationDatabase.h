@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	AnimationDatabase.h
+//	------------------------
+//	
+//	A packed binary file holding one shared skeleton and
+//	any number of clips, compiled offline from bvh files.
+//	At runtime the file is memory-mapped and clips point
+//	straight at its pages.
+//	
+//	Layout (native byte order, every section 16-byte aligned):
+//		DatabaseHeader
+//		DatabaseJoint[jointCount]		the shared skeleton
+//		DatabaseClip[clipCount]		per-clip headers
+//		char[nameBytes]			zero-terminated names
+//		float[...]			per clip, its rotation track
+//						(frame-major with x,y,z per joint)
+//						then its root position track
+//						(x,y,z per frame)
+//		RootMotionDelta[...]		per clip, its root motion track
+//		Quaternion[...]			per clip, its rotation track as
+//						quaternions (converted at compile
+//						time, frame-major)
+//	
+///////////////////////////////////////////////////
+
+#ifndef _ANIMATION_DATABASE_H
+#define _ANIMATION_DATABASE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BVHData.h"
+#include "MappedFile.h"
+
+// bump whenever the layout below changes
+const uint32_t ANIMATION_DATABASE_VERSION = 4;
+
+// file header
+struct DatabaseHeader
+	{ // struct DatabaseHeader
+	// "ANIMDB" followed by two zero bytes
+	char magic[8];
+	// layout version, must match ANIMATION_DATABASE_VERSION
+	uint32_t version;
+	// written as 0x01020304 to detect a foreign byte order
+	uint32_t byteOrder;
+	// number of joints in the shared skeleton
+	uint32_t jointCount;
+	// number of clips
+	uint32_t clipCount;
+	// byte offsets of the sections from the start of the file
+	uint64_t skeletonOffset;
+	uint64_t clipOffset;
+	uint64_t nameOffset;
+	uint64_t nameBytes;
+	}; // struct DatabaseHeader
+
+// a joint of the shared skeleton, in depth-first order
+struct DatabaseJoint
+	{ // struct DatabaseJoint
+	// index of the parent joint, -1 for the root
+	int32_t parent;
+	// offset from the parent
+	float offset[3];
+	// offset of the joint name in the name section
+	uint32_t nameOffset;
+	// number of animation channels
+	uint32_t channelCount;
+	// channel ids, as in BVHData::BVH_CHANNEL
+	uint8_t channels[8];
+	}; // struct DatabaseJoint
+
+// per-clip header
+struct DatabaseClip
+	{ // struct DatabaseClip
+	// offset of the clip name in the name section
+	uint32_t nameOffset;
+	// number of frames
+	uint32_t frameCount;
+	// seconds per frame
+	float frameTime;
+	// floats per frame in the source file
+	uint32_t channelCount;
+	// byte offsets of the rotation, root position, root motion and quaternion tracks from the start of the file
+	uint64_t rotationOffset;
+	uint64_t rootPositionOffset;
+	uint64_t rootMotionOffset;
+	uint64_t quaternionOffset;
+	}; // struct DatabaseClip
+
+class AnimationDatabase
+	{ // class AnimationDatabase
+	public:
+	// compile a set of bvh files into a database file
+	// all of the clips must share one skeleton; returns false on failure
+	static bool Compile(const std::vector<std::string> &bvhFiles, const char *databaseName, std::string &error);
+
+	// the name a bvh file is stored under: the file name without directory or extension
+	static std::string ClipName(const std::string &fileName);
+
+	// map a database file, returns true on success
+	bool Open(const char *databaseName);
+
+	// release the mapping (clips bound from it become invalid)
+	void Close();
+
+	// true if a database is mapped
+	bool IsOpen() const;
+
+	// number of clips in the database
+	int ClipCount() const;
+
+	// name of a clip
+	const char *ClipNameAt(int clip) const;
+
+	// index of the clip with a given name, or -1
+	int FindClip(const std::string &clipName) const;
+
+	// set up a bvh object to play a clip straight from the mapped pages
+	// the skeleton is rebuilt once, frame data is not copied
+	// returns false if the clip does not exist
+	bool BindClip(const std::string &clipName, BVHData &clip) const;
+
+	private:
+	// the mapped file
+	MappedFile file;
+
+	// pointers into the mapping
+	const DatabaseHeader *header = nullptr;
+	const DatabaseJoint *joints = nullptr;
+	const DatabaseClip *clips = nullptr;
+	const char *names = nullptr;
+	}; // class AnimationDatabase
+
+#endif
@@ -0,0 +1,838 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	AnimationTools.cpp
+//	------------------------
+//	
+//	Command-line tools and benchmarks that run without
+//	opening a window, selected by the first argument
+//	
+///////////////////////////////////////////////////
+
+#include "AnimationTools.h"
+#include "AnimationDatabase.h"
+#include "AssetLoader.h"
+#include "BVHData.h"
+#include "BVHStream.h"
+#include "CompressedClip.h"
+#include "Crowd.h"
+#include "MappedFile.h"
+#include "MotionMatching.h"
+#include "Pose.h"
+#include "PoseCache.h"
+#include "PoseKernels.h"
+#include "Terrain.h"
+#include "TransitionTable.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// the clips shipped with the application, used when no files are given
+static const char *defaultClips[] =
+	{ // defaultClips
+	"./models/stand.bvh",
+	"./models/fast_run.bvh",
+	"./models/veer_left.bvh",
+	"./models/veer_right.bvh",
+	"./models/walking.bvh"
+	}; // defaultClips
+
+// the most --bench-pose lets each clip's pose cache hold
+static const size_t poseCacheBytes = 4 << 20;
+
+// benchmarks write results here so the work they time is not optimised away
+static volatile float benchmarkSink;
+
+// collect the file arguments after the tool name, or fall back to the shipped clips
+static std::vector<std::string> ClipArguments(int argc, char **argv, int first)
+	{ // ClipArguments()
+	std::vector<std::string> files;
+	for (int arg = first; arg < argc; arg++)
+		files.push_back(argv[arg]);
+	if (files.empty())
+		for (const char *clip : defaultClips)
+			files.push_back(clip);
+	return files;
+	} // ClipArguments()
+
+// seconds elapsed since a given start time
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+	{ // SecondsSince()
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} // SecondsSince()
+
+// two kernels compared with each other are each timed this many times, taking turns, and
+// keep their best time, so that neither gains from running second
+static const int kernelRounds = 5;
+
+// parse throughput of the stream reader against the mapped reader
+static int BenchmarkParse(const std::vector<std::string> &files)
+	{ // BenchmarkParse()
+	// enough repetitions that the short clips give stable timings
+	const int repetitions = 200;
+	std::cout << std::left << std::setw(28) << "file" << std::right
+		<< std::setw(10) << "bytes" << std::setw(14) << "stream MB/s"
+		<< std::setw(14) << "mapped MB/s" << std::setw(10) << "speedup" << std::endl;
+	double totalBytes = 0.0, totalStream = 0.0, totalMapped = 0.0;
+	for (const std::string &file : files)
+		{ // per file
+		MappedFile sizeCheck;
+		if (!sizeCheck.Open(file.c_str()))
+			{ // missing file
+			std::cerr << "Unable to open " << file << std::endl;
+			return 1;
+			} // missing file
+		double bytes = (double) sizeCheck.Size() * repetitions;
+		sizeCheck.Close();
+
+		// the readers must agree before their speeds mean anything
+		BVHData streamed, mapped;
+		streamed.ReadFileBVHStream(file.c_str());
+		mapped.ReadFileBVH(file.c_str());
+		if (streamed.frame_count != mapped.frame_count || !streamed.skeleton.SameLayout(mapped.skeleton)
+			|| memcmp(streamed.channelData.Data(), mapped.channelData.Data(), mapped.channelData.Size() * sizeof(float)) != 0)
+			{ // mismatch
+			std::cerr << "Readers disagree on " << file << std::endl;
+			return 1;
+			} // mismatch
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int rep = 0; rep < repetitions; rep++)
+			{ // stream reader
+			BVHData clip;
+			clip.ReadFileBVHStream(file.c_str());
+			} // stream reader
+		double streamSeconds = SecondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		for (int rep = 0; rep < repetitions; rep++)
+			{ // mapped reader
+			BVHData clip;
+			clip.ReadFileBVH(file.c_str());
+			} // mapped reader
+		double mappedSeconds = SecondsSince(start);
+
+		std::cout << std::left << std::setw(28) << file << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(10) << (long) (bytes / repetitions)
+			<< std::setw(14) << bytes / streamSeconds / 1.0e6
+			<< std::setw(14) << bytes / mappedSeconds / 1.0e6
+			<< std::setw(9) << streamSeconds / mappedSeconds << "x" << std::endl;
+		totalBytes += bytes;
+		totalStream += streamSeconds;
+		totalMapped += mappedSeconds;
+		} // per file
+	std::cout << std::left << std::setw(38) << "total" << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(14) << totalBytes / totalStream / 1.0e6
+		<< std::setw(14) << totalBytes / totalMapped / 1.0e6
+		<< std::setw(9) << totalStream / totalMapped << "x" << std::endl;
+	return 0;
+	} // BenchmarkParse()
+
+// compile bvh files into a binary animation database
+static int CompileDatabase(const char *databaseName, const std::vector<std::string> &files)
+	{ // CompileDatabase()
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::string error;
+	if (!AnimationDatabase::Compile(files, databaseName, error))
+		{ // failed
+		std::cerr << "Unable to compile " << databaseName << ": " << error << std::endl;
+		return 1;
+		} // failed
+	double compileSeconds = SecondsSince(start);
+
+	// reopen it to check that it maps, and time binding every clip
+	AnimationDatabase database;
+	start = std::chrono::steady_clock::now();
+	if (!database.Open(databaseName))
+		{ // unreadable
+		std::cerr << "Compiled database " << databaseName << " does not open" << std::endl;
+		return 1;
+		} // unreadable
+	for (int clip = 0; clip < database.ClipCount(); clip++)
+		{ // per clip
+		BVHData bound;
+		database.BindClip(database.ClipNameAt(clip), bound);
+		std::cout << std::left << std::setw(20) << database.ClipNameAt(clip) << std::right
+			<< std::setw(6) << bound.frame_count << " frames" << std::endl;
+		} // per clip
+	double bindSeconds = SecondsSince(start);
+	std::cout << "wrote " << databaseName << " (" << database.ClipCount() << " clips) in "
+		<< std::fixed << std::setprecision(2) << compileSeconds * 1000.0 << " ms; "
+		<< "open and bind took " << bindSeconds * 1000.0 << " ms" << std::endl;
+	return 0;
+	} // CompileDatabase()
+
+// memory and seek cost of streaming a clip against loading it whole
+static int BenchmarkStream(const std::vector<std::string> &files, int chunkFrames, int residentChunks)
+	{ // BenchmarkStream()
+	for (const std::string &file : files)
+		{ // per file
+		BVHData whole, streamed;
+		if (!whole.ReadFileBVH(file.c_str()) || !streamed.ReadFileBVHStreaming(file.c_str(), chunkFrames, residentChunks))
+			{ // unreadable
+			std::cerr << "Unable to read " << file << std::endl;
+			return 1;
+			} // unreadable
+		int jointCount = whole.skeleton.JointCount();
+		size_t wholeBytes = whole.channelData.Size() * sizeof(float)
+			+ (whole.rotationData.Size() + whole.rootPositionData.Size()) * sizeof(Cartesian3);
+
+		// play straight through, checking every frame against the whole clip
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < streamed.frame_count; frame++)
+			for (int joint = 0; joint < jointCount; joint++)
+				if (!(streamed.JointRotation(frame, joint) == whole.JointRotation(frame, joint)))
+					{ // mismatch
+					std::cerr << file << ": frame " << frame << " differs when streamed" << std::endl;
+					return 1;
+					} // mismatch
+		double playSeconds = SecondsSince(start);
+
+		// then seek at random
+		const int seeks = 1000;
+		long decodedBefore = streamed.motionStream->ChunksDecoded();
+		srand(1);
+		start = std::chrono::steady_clock::now();
+		for (int seek = 0; seek < seeks; seek++)
+			benchmarkSink = streamed.JointRotation(rand() % streamed.frame_count, 0).x;
+		double seekSeconds = SecondsSince(start);
+
+		std::cout << file << ": " << streamed.frame_count << " frames, whole clip "
+			<< wholeBytes / 1024 << " KiB, streamed "
+			<< (streamed.motionStream->ResidentBytes() + streamed.motionStream->IndexBytes()) / 1024 << " KiB resident" << std::endl
+			<< "  playback " << std::fixed << std::setprecision(3) << playSeconds * 1000.0 << " ms, "
+			<< seeks << " random seeks " << seekSeconds * 1000.0 << " ms ("
+			<< streamed.motionStream->ChunksDecoded() - decodedBefore << " chunks decoded)" << std::endl;
+		} // per file
+	return 0;
+	} // BenchmarkStream()
+
+// load every clip in a directory on 1, 2, 4 ... threads
+static int BenchmarkLoad(const std::string &directory)
+	{ // BenchmarkLoad()
+	std::vector<std::string> files = AssetLoader::ListFiles(directory, ".bvh");
+	if (files.empty())
+		{ // nothing to load
+		std::cerr << "No .bvh files in " << directory << std::endl;
+		return 1;
+		} // nothing to load
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	double serialSeconds = 0.0;
+	bool allLoaded = true;
+	for (unsigned threads = 1; ; threads *= 2)
+		{ // per thread count
+		threads = std::min(threads, cores);
+		std::vector<BVHData> clips(files.size());
+		AssetLoader loader;
+		for (size_t clip = 0; clip < files.size(); clip++)
+			{ // per clip
+			const std::string &file = files[clip];
+			BVHData &target = clips[clip];
+			loader.Add(file, [&file, &target]() { return target.ReadFileBVH(file.c_str()); });
+			} // per clip
+		bool loaded = loader.Run(threads);
+		allLoaded = allLoaded && loaded;
+		if (threads == 1)
+			serialSeconds = loader.TotalSeconds();
+		std::cout << std::setw(3) << threads << " threads: " << files.size() << " clips in " << std::fixed << std::setprecision(2)
+			<< loader.TotalSeconds() * 1000.0 << " ms (" << serialSeconds / loader.TotalSeconds() << "x)"
+			<< (loaded ? "" : ", some clips FAILED") << std::endl;
+		if (threads == cores)
+			{ // show the detail of the widest run
+			loader.Report(std::cout);
+			break;
+			} // show the detail of the widest run
+		} // per thread count
+	// timings of clips that failed to load mean nothing
+	return allLoaded ? 0 : 1;
+	} // BenchmarkLoad()
+
+// compression ratio, worst-case joint error and decode cost of compressing each clip
+static int ReportCompression(const std::vector<std::string> &files, float maxError)
+	{ // ReportCompression()
+	std::cout << "maximum joint error " << maxError << (maxError > 0.0f ? "" : " (keys kept, quantized only)") << std::endl
+		<< std::left << std::setw(28) << "clip" << std::right << std::setw(8) << "frames"
+		<< std::setw(10) << "constant" << std::setw(8) << "keys" << std::setw(10) << "raw KiB"
+		<< std::setw(10) << "packed" << std::setw(8) << "ratio" << std::setw(12) << "max error"
+		<< std::setw(12) << "us/frame" << std::endl;
+	for (const std::string &file : files)
+		{ // per file
+		BVHData clip;
+		if (!clip.ReadFileBVH(file.c_str()) || clip.frame_count == 0)
+			{ // unreadable
+			std::cerr << "Unable to read " << file << std::endl;
+			return 1;
+			} // unreadable
+		size_t rawBytes = (clip.rotationData.Size() + clip.rootPositionData.Size()) * sizeof(Cartesian3);
+
+		CompressedClip compressed;
+		compressed.Compress(clip, maxError);
+		float worstError = compressed.MeasureError(clip);
+
+		// time decoding every frame, as the per-frame update would
+		std::vector<Cartesian3> rotations(clip.skeleton.JointCount());
+		Cartesian3 rootPosition;
+		const int passes = 100;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			for (int frame = 0; frame < clip.frame_count; frame++)
+				{ // per frame
+				compressed.DecodeFrame(frame, rotations.data(), rootPosition);
+				benchmarkSink = rotations[0].x;
+				} // per frame
+		double frameSeconds = SecondsSince(start) / ((double) passes * clip.frame_count);
+
+		size_t totalKeys = (size_t) compressed.TrackCount() * clip.frame_count;
+		std::cout << std::left << std::setw(28) << file << std::right << std::setw(8) << clip.frame_count
+			<< std::setw(6) << compressed.ConstantTracks() << "/" << std::setw(3) << compressed.TrackCount()
+			<< std::setw(7) << std::fixed << std::setprecision(0) << 100.0 * compressed.KeyCount() / totalKeys << "%"
+			<< std::setw(10) << std::setprecision(1) << rawBytes / 1024.0
+			<< std::setw(10) << compressed.CompressedBytes() / 1024.0
+			<< std::setw(7) << (double) rawBytes / compressed.CompressedBytes() << "x"
+			<< std::setw(12) << std::setprecision(4) << worstError
+			<< std::setw(12) << std::setprecision(2) << frameSeconds * 1.0e6 << std::endl;
+		} // per file
+	return 0;
+	} // ReportCompression()
+
+// cost of evaluating a pose (forward kinematics, no drawing) for every frame of each clip
+static int BenchmarkPose(const std::vector<std::string> &files)
+	{ // BenchmarkPose()
+	for (const std::string &file : files)
+		{ // per file
+		BVHData clip;
+		if (!clip.ReadFileBVH(file.c_str()) || clip.frame_count == 0)
+			{ // unreadable
+			std::cerr << "Unable to read " << file << std::endl;
+			return 1;
+			} // unreadable
+		// a pose of this clip's own, so nothing carries over from the last
+		Pose pose;
+		// play the clip through enough times for the timing to settle, evaluating every
+		// pose in full
+		int passes = std::max(1, 20000 / clip.frame_count);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			for (int frame = 0; frame < clip.frame_count; frame++)
+				{ // per frame
+				pose.Forget();
+				EvaluatePose(clip, frame * clip.frame_time, pose);
+				benchmarkSink = pose.model.back().coordinates[0][3];
+				} // per frame
+		double poseSeconds = SecondsSince(start) / ((double) passes * clip.frame_count);
+		// then as it is played, skipping the joints (or whole poses) that have not changed
+		pose.counters = PoseCounters();
+		start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			for (int frame = 0; frame < clip.frame_count; frame++)
+				{ // per frame
+				EvaluatePose(clip, frame * clip.frame_time, pose);
+				benchmarkSink = pose.model.back().coordinates[0][3];
+				} // per frame
+		double playedSeconds = SecondsSince(start) / ((double) passes * clip.frame_count);
+		PoseCounters counters = pose.counters;
+
+		// the generic kernel the skeleton falls back on, against the one it picked; both take
+		// the same product per joint, so this is only what compiling for the joint count adds
+		double kernelSeconds[2] = { 1.0e30, 1.0e30 };
+		const PoseKernels *kernels[2] = { &GenericPoseKernels(), clip.skeleton.kernels };
+		for (int round = 0; round < kernelRounds; round++)
+			for (int which = 0; which < 2; which++)
+				{ // per kernel
+				start = std::chrono::steady_clock::now();
+				for (int pass = 0; pass < passes; pass++)
+					for (int frame = 0; frame < clip.frame_count; frame++)
+						{ // per frame
+						kernels[which]->forwardKinematics(clip.skeleton, clip.FrameQuaternions(frame), pose.model.data());
+						benchmarkSink = pose.model.back().coordinates[0][3];
+						} // per frame
+				kernelSeconds[which] = std::min(kernelSeconds[which], SecondsSince(start) / ((double) passes * clip.frame_count));
+				} // per kernel
+		// the buffer was written behind the pose's back
+		pose.Forget();
+
+		// only the chains down to the feet, as a contact query needs
+		std::vector<int> feet;
+		for (int joint = 0; joint < clip.skeleton.JointCount(); joint++)
+			if (clip.skeleton.Name(joint).find("Foot") != std::string::npos)
+				feet.push_back(joint);
+		JointChain chain(clip.skeleton, feet);
+		start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			for (int frame = 0; frame < clip.frame_count; frame++)
+				{ // per frame
+				EvaluateChain(clip, frame, chain, pose);
+				benchmarkSink = pose.model[chain.joints.back()].coordinates[0][3];
+				} // per frame
+		double chainSeconds = SecondsSince(start) / ((double) passes * clip.frame_count);
+
+		// and again with every frame baked into the clip's pose cache (copied every time,
+		// rather than skipped when the pose already shows the frame)
+		clip.CachePoses(poseCacheBytes, true);
+		start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			for (int frame = 0; frame < clip.frame_count; frame++)
+				{ // per frame
+				pose.Forget();
+				EvaluatePose(clip, frame * clip.frame_time, pose);
+				benchmarkSink = pose.model.back().coordinates[0][3];
+				} // per frame
+		double cachedSeconds = SecondsSince(start) / ((double) passes * clip.frame_count);
+		std::cout << std::left << std::setw(28) << file << std::right << std::setw(4) << clip.skeleton.JointCount() << " joints  "
+			<< std::fixed << std::setprecision(2) << poseSeconds * 1.0e6 << " us/pose  "
+			<< std::setprecision(0) << 1.0 / poseSeconds << " poses/s  played " << std::setprecision(2)
+			<< playedSeconds * 1.0e6 << " us/pose (" << std::setprecision(0)
+			<< 100.0 * counters.jointsSkipped / std::max(1L, counters.jointsEvaluated + counters.jointsSkipped) << "% joints skipped)  generic "
+			<< std::setprecision(2) << kernelSeconds[0] * 1.0e6 << " us, " << kernels[1]->name << " "
+			<< kernelSeconds[1] * 1.0e6 << " us  feet (" << chain.joints.size() << " joints) "
+			<< chainSeconds * 1.0e6 << " us  cached "
+			<< std::setprecision(2) << cachedSeconds * 1.0e6 << " us/pose ("
+			<< clip.poseCache->CachedFrames() << " frames, " << std::setprecision(1) << clip.poseCache->Bytes() / 1024.0 << " KiB, "
+			<< clip.poseCache->Hits() << " hits)" << std::endl;
+		} // per file
+	return 0;
+	} // BenchmarkPose()
+
+// a crowd of characters wandering between the shipped clips, updated for some frames on
+// 1, 2, 4 ... threads; the state it ends in is hashed to show it does not depend on the threads
+static int BenchmarkCrowd(int characters, int frames)
+	{ // BenchmarkCrowd()
+	std::vector<ClipHandle> clips;
+	for (const char *file : defaultClips)
+		{ // per clip
+		std::shared_ptr<BVHData> clip = std::make_shared<BVHData>();
+		if (!clip->ReadFileBVH(file) || clip->frame_count == 0)
+			{ // unreadable
+			std::cerr << "Unable to read " << file << std::endl;
+			return 1;
+			} // unreadable
+		// as the application loads them
+		clip->Resample(1.0f / 24.0f);
+		clip->CachePoses(poseCacheBytes, true);
+		clips.push_back(clip);
+		} // per clip
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << characters << " characters, " << frames << " frames, " << cores << " cores" << std::endl;
+	unsigned long long firstHash = 0;
+	for (unsigned threads = 1; ; threads *= 2)
+		{ // per thread count
+		threads = std::min(threads, cores);
+		// the same crowd every time
+		Crowd crowd(threads);
+		crowd.scale = 0.1f;
+		int side = (int) ceil(sqrt((double) characters));
+		for (int character = 0; character < characters; character++)
+			crowd.Add(clips[character % clips.size()], Cartesian3((character % side) * 4.0f, (character / side) * 4.0f, 0.0f),
+				(float) (character * 37 % 360), 0.0f);
+		crowd.Wander(clips, 1.0f, 0.25f);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+			crowd.Update(1.0f / 24.0f);
+		double seconds = SecondsSince(start);
+
+		// FNV-1a over every character's final place and pose
+		unsigned long long hash = 14695981039346656037ull;
+		auto mix = [&hash](const void *data, size_t bytes)
+			{ // mix
+			for (size_t byte = 0; byte < bytes; byte++)
+				hash = (hash ^ ((const unsigned char *) data)[byte]) * 1099511628211ull;
+			}; // mix
+		for (int character = 0; character < characters; character++)
+			{ // per character
+			mix(&crowd.location[character], sizeof(Cartesian3));
+			mix(&crowd.heading[character], sizeof(float));
+			mix(crowd.pose[character].model.data(), crowd.pose[character].model.size() * sizeof(Matrix4));
+			} // per character
+		if (threads == 1)
+			firstHash = hash;
+
+		std::cout << std::setw(4) << threads << " threads  " << std::fixed << std::setprecision(2)
+			<< seconds * 1000.0 / frames << " ms/frame  " << std::setprecision(0)
+			<< characters * frames / (seconds * 1000.0) << " characters/ms  state " << std::hex << hash << std::dec
+			<< (hash == firstHash ? "" : "  (differs from 1 thread)") << std::endl;
+		if (threads == cores)
+			{ // last run
+			PoseCounters counters = crowd.Counters();
+			std::cout << "poses: " << counters.posesEvaluated << " evaluated, " << counters.posesCached << " from the cache, "
+				<< counters.posesSkipped << " skipped; joints: " << counters.jointsEvaluated << " evaluated, "
+				<< counters.jointsSkipped << " skipped" << std::endl;
+			break;
+			} // last run
+		} // per thread count
+	return 0;
+	} // BenchmarkCrowd()
+
+// time building the best-transition table between clips, and looking entries up
+static int BenchmarkTransitions(const std::vector<std::string> &files)
+	{ // BenchmarkTransitions()
+	std::vector<ClipHandle> clips;
+	size_t rows = 0;
+	for (const std::string &file : files)
+		{ // per clip
+		std::shared_ptr<BVHData> clip = std::make_shared<BVHData>();
+		if (!clip->ReadFileBVH(file.c_str()) || clip->frame_count == 0)
+			{ // unreadable
+			std::cerr << "Unable to read " << file << std::endl;
+			return 1;
+			} // unreadable
+		// as the application loads them
+		clip->Resample(1.0f / 24.0f);
+		clip->CachePoses(poseCacheBytes, true);
+		clips.push_back(clip);
+		rows += clip->frame_count;
+		} // per clip
+
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	std::cout << clips.size() << " clips, " << rows << " frames, " << rows * rows << " pose distances" << std::endl;
+	TransitionTable table;
+	for (unsigned threads = 1; ; threads *= 2)
+		{ // per thread count
+		threads = std::min(threads, cores);
+		table.Build(clips, threads);
+		std::cout << std::setw(4) << threads << " threads  " << std::fixed << std::setprecision(2) << table.buildSeconds * 1000.0
+			<< " ms  " << std::setprecision(0) << rows * rows / (table.buildSeconds * 1000.0) << " distances/ms" << std::endl;
+		if (threads == cores)
+			break;
+		} // per thread count
+
+	// a lookup from every frame into every clip
+	const int passes = 1000;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int sum = 0;
+	for (int pass = 0; pass < passes; pass++)
+		for (const ClipHandle &from : clips)
+			for (int frame = 0; frame < from->frame_count; frame++)
+				for (const ClipHandle &to : clips)
+					sum += table.BestEntry(*from, frame, *to);
+	benchmarkSink = (float) sum;
+	double seconds = SecondsSince(start);
+	std::cout << "lookup " << std::setprecision(1) << seconds * 1.0e9 / ((double) passes * rows * clips.size()) << " ns, table "
+		<< rows * clips.size() * sizeof(uint16_t) << " bytes" << std::endl;
+
+	// and where each clip is entered from the first frame of each
+	for (const ClipHandle &from : clips)
+		{ // per source clip
+		std::cout << std::left << std::setw(32) << files[&from - &clips[0]] << std::right;
+		for (const ClipHandle &to : clips)
+			std::cout << std::setw(6) << table.BestEntry(*from, 0, *to);
+		std::cout << std::endl;
+		} // per source clip
+	return 0;
+	} // BenchmarkTransitions()
+
+// time motion-matching searches through hours of clips, through the KD-tree and frame by frame
+static int BenchmarkMatch(float hours, int queries)
+	{ // BenchmarkMatch()
+	// the shipped clips over and over, each time played a little faster (by resampling
+	// to a longer frame time), until there are enough frames at 24 fps
+	const float frameTime = 1.0f / 24.0f;
+	size_t wanted = (size_t) (hours * 3600.0f / frameTime), frames = 0;
+	std::vector<ClipHandle> clips;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int copy = 0; frames < wanted || copy == 0; copy++)
+		for (const char *file : defaultClips)
+			{ // per clip
+			std::shared_ptr<BVHData> clip = std::make_shared<BVHData>();
+			if (!clip->ReadFileBVH(file) || clip->frame_count == 0)
+				{ // unreadable
+				std::cerr << "Unable to read " << file << std::endl;
+				return 1;
+				} // unreadable
+			clip->Resample(frameTime * (1.0f + 0.001f * copy));
+			frames += clip->frame_count;
+			clips.push_back(clip);
+			} // per clip
+	double loadSeconds = SecondsSince(start);
+	MotionDatabase database;
+	start = std::chrono::steady_clock::now();
+	database.Build(clips);
+	std::cout << database.RowCount() << " frames (" << std::fixed << std::setprecision(2) << database.RowCount() * frameTime / 3600.0f
+		<< " hours) from " << clips.size() << " clips, loaded in " << loadSeconds << " s, described in " << SecondsSince(start) << " s" << std::endl;
+
+	// queries from frames spread through the database, each asking for the motion of one
+	// of the shipped clips (the trajectories the arrow keys ask for)
+	std::vector<std::vector<float>> trajectories;
+	for (int clip = 0; clip < (int) (sizeof(defaultClips) / sizeof(defaultClips[0])); clip++)
+		{ // per shipped clip
+		Cartesian3 velocity;
+		float turnRate;
+		MotionDatabase::ClipMotion(*clips[clip], velocity, turnRate);
+		trajectories.push_back(std::vector<float>(MotionDatabase::trajectoryFeatures));
+		MotionDatabase::ConstantTrajectory(velocity, turnRate, trajectories.back().data());
+		} // per shipped clip
+	AlignedBuffer<float> query;
+	query.Resize((size_t) queries * MotionDatabase::stride);
+	std::vector<int> startRows(queries);
+	for (int index = 0; index < queries; index++)
+		{ // per query
+		startRows[index] = (int) ((long long) index * 7919 % database.RowCount());
+		database.Query(startRows[index], trajectories[index % trajectories.size()].data(), query.Data() + (size_t) index * MotionDatabase::stride);
+		} // per query
+
+	std::vector<MotionMatch> bounded(queries), scanned(queries);
+	start = std::chrono::steady_clock::now();
+	for (int index = 0; index < queries; index++)
+		bounded[index] = database.Search(query.Data() + (size_t) index * MotionDatabase::stride, startRows[index]);
+	double boundedSeconds = SecondsSince(start);
+	start = std::chrono::steady_clock::now();
+	for (int index = 0; index < queries; index++)
+		scanned[index] = database.SearchEveryFrame(query.Data() + (size_t) index * MotionDatabase::stride, startRows[index]);
+	double scannedSeconds = SecondsSince(start);
+	int differ = 0;
+	for (int index = 0; index < queries; index++)
+		differ += bounded[index].row != scanned[index].row;
+
+	std::cout << "KD-tree         " << std::setprecision(1) << boundedSeconds * 1.0e6 / queries << " us/query" << std::endl;
+	std::cout << "every frame     " << scannedSeconds * 1.0e6 / queries << " us/query" << std::endl;
+	std::cout << queries << " queries, " << differ << " answered differently" << std::endl;
+	return differ == 0 ? 0 : 1;
+	} // BenchmarkMatch()
+
+// the plain loops Matrix4 used before it had SIMD kernels, kept as a reference for benchmarking
+static Matrix4 ReferenceProduct(const Matrix4 &left, const Matrix4 &right)
+	{ // ReferenceProduct()
+	Matrix4 product;
+	for (int row = 0; row < 4; row++)
+		for (int col = 0; col < 4; col++)
+			for (int entry = 0; entry < 4; entry++)
+				product.coordinates[row][col] += left.coordinates[row][entry] * right.coordinates[entry][col];
+	return product;
+	} // ReferenceProduct()
+
+static Matrix4 ReferenceTranspose(const Matrix4 &matrix)
+	{ // ReferenceTranspose()
+	Matrix4 transposed;
+	for (int row = 0; row < 4; row++)
+		for (int col = 0; col < 4; col++)
+			transposed.coordinates[row][col] = matrix.coordinates[col][row];
+	return transposed;
+	} // ReferenceTranspose()
+
+static Homogeneous4 ReferenceTransform(const Matrix4 &matrix, const Homogeneous4 &vector)
+	{ // ReferenceTransform()
+	Homogeneous4 product;
+	for (int row = 0; row < 4; row++)
+		for (int col = 0; col < 4; col++)
+			product[row] += matrix.coordinates[row][col] * vector[col];
+	return product;
+	} // ReferenceTransform()
+
+// the most a joint may be from where the reference puts it, in clip units, for the
+// kernels to count as agreeing (rounding leaves them about 1e-4 apart)
+static const float fkTolerance = 1.0e-3f;
+
+// forward kinematics as EvaluatePose used to do it, from the Euler angles through the reference loops
+static void ReferencePose(const BVHData &clip, int frame, Pose &pose)
+	{ // ReferencePose()
+	const Skeleton &skeleton = clip.skeleton;
+	const Cartesian3 *rotations = clip.FrameRotations(frame);
+	for (int joint = 0; joint < skeleton.JointCount(); joint++)
+		{ // per joint
+		const Cartesian3 &rotation = rotations[joint];
+		Matrix4 eulerMatrix = ReferenceProduct(ReferenceProduct(Matrix4::RotateZ(rotation.z), Matrix4::RotateY(rotation.y)), Matrix4::RotateX(rotation.x));
+		Matrix4 local = ReferenceProduct(Matrix4::Translate(skeleton.offset[joint]), ReferenceTranspose(eulerMatrix));
+		int parent = skeleton.parent[joint];
+		pose.model[joint] = parent < 0 ? local : ReferenceProduct(pose.model[parent], local);
+		} // per joint
+	} // ReferencePose()
+
+// forward kinematics from a frame's quaternions, a joint at a time, with each product taken
+// either by Matrix4 (its SIMD kernels, unless MATRIX4_NO_SIMD is defined) or by its scalar
+// fallback, so that the two differ only in the product
+template <bool MatrixKernels>
+static void QuaternionPose(const BVHData &clip, int frame, Pose &pose)
+	{ // QuaternionPose()
+	const Skeleton &skeleton = clip.skeleton;
+	const Quaternion *rotations = clip.FrameQuaternions(frame);
+	for (int joint = 0; joint < skeleton.JointCount(); joint++)
+		{ // per joint
+		Matrix4 local = rotations[joint].GetMatrix(skeleton.offset[joint]);
+		int parent = skeleton.parent[joint];
+		if (parent < 0)
+			pose.model[joint] = local;
+		else
+			pose.model[joint] = MatrixKernels ? pose.model[parent] * local : Matrix4::ScalarProduct(pose.model[parent], local);
+		} // per joint
+	} // QuaternionPose()
+
+// the Matrix4 kernels against the reference loops, in forward kinematics and the terrain
+// transform, and the forward kinematics the application runs against the old Euler path
+static int BenchmarkMath(const std::vector<std::string> &files)
+	{ // BenchmarkMath()
+	std::cout << "Matrix4 kernels: " << Matrix4::Implementation() << std::endl;
+	float worstOverall = 0.0f;
+	for (const std::string &file : files)
+		{ // per file
+		BVHData clip;
+		if (!clip.ReadFileBVH(file.c_str()) || clip.frame_count == 0)
+			{ // unreadable
+			std::cerr << "Unable to read " << file << std::endl;
+			return 1;
+			} // unreadable
+		// poses of this clip's own, so nothing carries over from the last
+		Pose pose, referencePose;
+		int jointCount = clip.skeleton.JointCount();
+		referencePose.model.resize(jointCount);
+		int passes = std::max(1, 20000 / clip.frame_count);
+
+		// the kernels may round differently, so check they agree as well
+		float worstDifference = 0.0f;
+		for (int frame = 0; frame < clip.frame_count; frame++)
+			{ // per frame
+			EvaluateFrame(clip, frame, pose);
+			ReferencePose(clip, frame, referencePose);
+			for (int joint = 0; joint < jointCount; joint++)
+				worstDifference = std::max(worstDifference, (pose.Position(joint) - referencePose.Position(joint)).length());
+			} // per frame
+		worstOverall = std::max(worstOverall, worstDifference);
+
+		// the same forward kinematics with the scalar product and with Matrix4's
+		pose.model.resize(jointCount);
+		pose.Forget();
+		// taken in turns, keeping the best of each, so that neither gains from going second
+		double scalarSeconds = 1.0e30, kernelSeconds = 1.0e30;
+		std::chrono::steady_clock::time_point start;
+		for (int round = 0; round < kernelRounds; round++)
+			{ // per round
+			start = std::chrono::steady_clock::now();
+			for (int pass = 0; pass < passes; pass++)
+				for (int frame = 0; frame < clip.frame_count; frame++)
+					{ // per frame
+					QuaternionPose<false>(clip, frame, pose);
+					benchmarkSink = pose.model.back().coordinates[0][3];
+					} // per frame
+			scalarSeconds = std::min(scalarSeconds, SecondsSince(start) / ((double) passes * clip.frame_count));
+			start = std::chrono::steady_clock::now();
+			for (int pass = 0; pass < passes; pass++)
+				for (int frame = 0; frame < clip.frame_count; frame++)
+					{ // per frame
+					QuaternionPose<true>(clip, frame, pose);
+					benchmarkSink = pose.model.back().coordinates[0][3];
+					} // per frame
+			kernelSeconds = std::min(kernelSeconds, SecondsSince(start) / ((double) passes * clip.frame_count));
+			} // per round
+
+		// and, for comparison, the Euler angles through the reference loops against EvaluateFrame
+		start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			for (int frame = 0; frame < clip.frame_count; frame++)
+				{ // per frame
+				ReferencePose(clip, frame, referencePose);
+				benchmarkSink = referencePose.model.back().coordinates[0][3];
+				} // per frame
+		double referenceSeconds = SecondsSince(start) / ((double) passes * clip.frame_count);
+		start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < passes; pass++)
+			for (int frame = 0; frame < clip.frame_count; frame++)
+				{ // per frame
+				pose.Forget();
+				EvaluateFrame(clip, frame, pose);
+				benchmarkSink = pose.model.back().coordinates[0][3];
+				} // per frame
+		double poseSeconds = SecondsSince(start) / ((double) passes * clip.frame_count);
+		std::cout << "FK " << std::left << std::setw(28) << file << std::right << std::setw(4) << jointCount << " joints  "
+			<< std::fixed << std::setprecision(2) << "scalar " << scalarSeconds * 1.0e6 << " -> " << Matrix4::Implementation() << " " << kernelSeconds * 1.0e6 << " us/pose  "
+			<< scalarSeconds / kernelSeconds << "x  Euler reference " << referenceSeconds * 1.0e6 << " -> EvaluateFrame "
+			<< poseSeconds * 1.0e6 << " us/pose  (max difference " << std::scientific << std::setprecision(1)
+			<< worstDifference << ")" << std::defaultfloat << std::endl;
+		} // per file
+
+	// the terrain is transformed into view space every frame before it is drawn
+	Terrain terrain;
+	if (!terrain.ReadFileTerrainData("./models/randomland.dem", 3))
+		{ // no terrain
+		std::cerr << "Unable to read ./models/randomland.dem" << std::endl;
+		return 1;
+		} // no terrain
+	size_t vertexCount = terrain.vertices.size();
+	std::vector<Homogeneous4> transformed(vertexCount);
+	Matrix4 viewMatrix = Matrix4::Translate(Cartesian3(-40.0f, -40.0f, -20.0f)) * Matrix4::RotateX(-60.0f) * Matrix4::RotateZ(30.0f);
+	const int passes = 200;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+		{ // per pass
+		for (size_t vertex = 0; vertex < vertexCount; vertex++)
+			transformed[vertex] = ReferenceTransform(viewMatrix, terrain.vertices[vertex]);
+		benchmarkSink = transformed.back().x;
+		} // per pass
+	double referenceSeconds = SecondsSince(start) / passes;
+	start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < passes; pass++)
+		{ // per pass
+		viewMatrix.Transform(terrain.vertices.data(), transformed.data(), vertexCount);
+		benchmarkSink = transformed.back().x;
+		} // per pass
+	double batchSeconds = SecondsSince(start) / passes;
+	std::cout << "terrain " << vertexCount << " vertices  " << std::fixed << std::setprecision(1)
+		<< referenceSeconds * 1.0e6 << " -> " << batchSeconds * 1.0e6 << " us/frame  "
+		<< std::setprecision(2) << referenceSeconds / batchSeconds << "x" << std::endl;
+	// a pose further from the reference than rounding explains is wrong, however fast
+	if (worstOverall > fkTolerance)
+		{ // disagree
+		std::cerr << "forward kinematics differ from the reference by " << worstOverall << std::endl;
+		return 1;
+		} // disagree
+	return 0;
+	} // BenchmarkMath()
+
+// runs the tool named by argv[1], if any
+int RunAnimationTool(int argc, char **argv)
+	{ // RunAnimationTool()
+	// no arguments means run the application as normal
+	if (argc < 2)
+		return -1;
+	if (strcmp(argv[1], "--bench-parse") == 0)
+		return BenchmarkParse(ClipArguments(argc, argv, 2));
+	if (strcmp(argv[1], "--compile-db") == 0)
+		{ // compile a database
+		if (argc < 3)
+			{ // no output
+			std::cerr << "usage: " << argv[0] << " --compile-db output.adb [file.bvh ...]" << std::endl;
+			return 1;
+			} // no output
+		return CompileDatabase(argv[2], ClipArguments(argc, argv, 3));
+		} // compile a database
+	if (strcmp(argv[1], "--bench-stream") == 0)
+		{ // streaming
+		// optional chunk and window sizes come first
+		int chunkFrames = 64, residentChunks = 4, first = 2;
+		if (argc > first && isdigit(argv[first][0]))
+			chunkFrames = atoi(argv[first++]);
+		if (argc > first && isdigit(argv[first][0]))
+			residentChunks = atoi(argv[first++]);
+		return BenchmarkStream(ClipArguments(argc, argv, first), chunkFrames, residentChunks);
+		} // streaming
+	if (strcmp(argv[1], "--bench-pose") == 0)
+		return BenchmarkPose(ClipArguments(argc, argv, 2));
+	if (strcmp(argv[1], "--bench-crowd") == 0)
+		return BenchmarkCrowd(argc > 2 ? atoi(argv[2]) : 4096, argc > 3 ? atoi(argv[3]) : 240);
+	if (strcmp(argv[1], "--bench-transitions") == 0)
+		return BenchmarkTransitions(ClipArguments(argc, argv, 2));
+	if (strcmp(argv[1], "--bench-match") == 0)
+		return BenchmarkMatch(argc > 2 ? (float) atof(argv[2]) : 1.0f, argc > 3 ? atoi(argv[3]) : 1000);
+	if (strcmp(argv[1], "--bench-math") == 0)
+		return BenchmarkMath(ClipArguments(argc, argv, 2));
+	if (strcmp(argv[1], "--compress") == 0)
+		{ // compression report
+		// an optional error bound comes first
+		float maxError = 0.1f;
+		int first = 2;
+		if (argc > first && (isdigit(argv[first][0]) || argv[first][0] == '.'))
+			maxError = (float) atof(argv[first++]);
+		return ReportCompression(ClipArguments(argc, argv, first), maxError);
+		} // compression report
+	if (strcmp(argv[1], "--bench-load") == 0)
+		return BenchmarkLoad(argc > 2 ? argv[2] : "./models");
+	// anything else is left for the application
+	return -1;
+	} // RunAnimationTool()
@@ -0,0 +1,19 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	AnimationTools.h
+//	------------------------
+//	
+//	Command-line tools and benchmarks that run without
+//	opening a window, selected by the first argument
+//	
+///////////////////////////////////////////////////
+
+#ifndef _ANIMATION_TOOLS_H
+#define _ANIMATION_TOOLS_H
+
+// runs the tool named by argv[1], if any
+// returns the exit code of the tool, or -1 if no tool was requested
+int RunAnimationTool(int argc, char **argv);
+
+#endif
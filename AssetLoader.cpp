@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	AssetLoader.cpp
+//	------------------------
+//	
+//	Loads a batch of independent assets at the same time
+//	on a pool of worker threads, timing each of them
+//	
+///////////////////////////////////////////////////
+
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <thread>
+
+// queue an asset
+void AssetLoader::Add(const std::string &name, std::function<bool()> load)
+	{ // Add()
+	Asset asset;
+	asset.name = name;
+	asset.load = load;
+	assets.push_back(asset);
+	} // Add()
+
+// run every queued load on a pool of threads and wait for all of them
+bool AssetLoader::Run(unsigned threadCount)
+	{ // Run()
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min<unsigned>(threadCount, std::max<size_t>(assets.size(), 1));
+
+	std::chrono::steady_clock::time_point batchStart = std::chrono::steady_clock::now();
+	// each worker claims the next unclaimed asset until there are none left
+	// assets are written only by the worker that claimed them, so no locking is needed
+	std::atomic<size_t> nextAsset(0);
+	auto worker = [this, &nextAsset]()
+		{ // worker
+		for (size_t index = nextAsset++; index < assets.size(); index = nextAsset++)
+			{ // per asset
+			Asset &asset = assets[index];
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			asset.loaded = asset.load();
+			asset.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			} // per asset
+		}; // worker
+
+	// the calling thread works too, rather than sitting idle until the join
+	std::vector<std::thread> pool;
+	for (unsigned thread = 1; thread < threadCount; thread++)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread &thread : pool)
+		thread.join();
+
+	totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+	threadsUsed = threadCount;
+	return std::all_of(assets.begin(), assets.end(), [](const Asset &asset) { return asset.loaded; });
+	} // Run()
+
+// print the time taken by each asset and by the whole batch
+void AssetLoader::Report(std::ostream &outStream) const
+	{ // Report()
+	double summedSeconds = 0.0;
+	for (const Asset &asset : assets)
+		{ // per asset
+		outStream << std::left << std::setw(32) << asset.name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << asset.seconds * 1000.0 << " ms" << (asset.loaded ? "" : "  FAILED") << std::endl;
+		summedSeconds += asset.seconds;
+		} // per asset
+	outStream << assets.size() << " assets on " << threadsUsed << " threads: " << std::fixed << std::setprecision(2)
+		<< totalSeconds * 1000.0 << " ms wall, " << summedSeconds * 1000.0 << " ms summed" << std::endl;
+	} // Report()
+
+// wall time of the last run, in seconds
+double AssetLoader::TotalSeconds() const
+	{ // TotalSeconds()
+	return totalSeconds;
+	} // TotalSeconds()
+
+// the files in a directory with a given extension, sorted by name
+std::vector<std::string> AssetLoader::ListFiles(const std::string &directory, const std::string &extension)
+	{ // ListFiles()
+	std::vector<std::string> files;
+	// every call that can fail reports through an error code rather than throwing, so a
+	// directory that cannot be read (or an entry that cannot be looked at) is skipped
+	std::error_code error;
+	std::filesystem::directory_iterator end;
+	for (std::filesystem::directory_iterator entry(directory, error); !error && entry != end; entry.increment(error))
+		{ // per entry
+		std::error_code typeError;
+		// hidden files include the resource forks that macOS leaves beside copied files
+		if (entry->is_regular_file(typeError) && entry->path().extension() == extension
+			&& entry->path().filename().string()[0] != '.')
+			files.push_back(entry->path().string());
+		} // per entry
+	std::sort(files.begin(), files.end());
+	return files;
+	} // ListFiles()
@@ -0,0 +1,59 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	AssetLoader.h
+//	------------------------
+//	
+//	Loads a batch of independent assets at the same time
+//	on a pool of worker threads, timing each of them
+//	
+///////////////////////////////////////////////////
+
+#ifndef _ASSET_LOADER_H
+#define _ASSET_LOADER_H
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class AssetLoader
+	{ // class AssetLoader
+	public:
+	// queue an asset; the load routine returns true on success
+	// routines run concurrently, so each must only touch its own asset
+	void Add(const std::string &name, std::function<bool()> load);
+
+	// run every queued load on a pool of threads and wait for all of them
+	// a thread count of 0 means one per core; returns true if every asset loaded
+	bool Run(unsigned threadCount = 0);
+
+	// print the time taken by each asset and by the whole batch
+	void Report(std::ostream &outStream) const;
+
+	// wall time of the last run, in seconds
+	double TotalSeconds() const;
+
+	// the files in a directory with a given extension, sorted by name (as many as could
+	// be listed, if the directory cannot be read to the end; never throws)
+	static std::vector<std::string> ListFiles(const std::string &directory, const std::string &extension);
+
+	private:
+	// a queued asset and the result of loading it
+	struct Asset
+		{ // struct Asset
+		std::string name;
+		std::function<bool()> load;
+		double seconds = 0.0;
+		bool loaded = false;
+		}; // struct Asset
+
+	// the batch
+	std::vector<Asset> assets;
+
+	// wall time of the last run and the threads it used
+	double totalSeconds = 0.0;
+	unsigned threadsUsed = 0;
+	}; // class AssetLoader
+
+#endif
@@ -1,14 +1,212 @@
 #include "BVHData.h"
+#include "BVHStream.h"
+#include "CompressedClip.h"
+#include "GaitTrack.h"
+#include "Pose.h"
+#include "PoseCache.h"
+#include "MappedFile.h"
+
+#include <atomic>
+
+// the last serial handed to a clip (0 is never handed out, so a new pose matches no clip)
+static std::atomic<unsigned long long> lastSerial(0);
+
+// the clips are y-up with z forward, the scene is z-up
+const Matrix4 clipToScene = Matrix4::RotateX(-90.0);
+
+// id for each channel
+const std::map<std::string, int, std::less<>> BVHData::BVH_CHANNEL =
+    { // BVH_CHANNEL
+        {"Xposition", 0},
+        {"Yposition", 1},
+        {"Zposition", 2},
+        {"Xrotation", 3},
+        {"Yrotation", 4},
+        {"Zrotation", 5}
+    }; // BVH_CHANNEL
+
+// id of a named channel, or -1 if it is not one we know
+int BVHData::ChannelId(std::string_view channelName)
+{ // ChannelId()
+    std::map<std::string, int, std::less<>>::const_iterator found = BVH_CHANNEL.find(channelName);
+    return found == BVH_CHANNEL.end() ? -1 : found->second;
+} // ChannelId()
 
 // constructor
 BVHData::BVHData()
 { // constructor
+    NewSerial();
 } // constructor
 
+// give the clip a new serial
+void BVHData::NewSerial()
+{ // NewSerial()
+    serial = ++lastSerial;
+} // NewSerial()
+
 // read data from bvh file
-// a basic recursive-descent parser
+// the file is mapped into memory and tokenised in place
 bool BVHData::ReadFileBVH(const char *fileName)
 { // ReadFileBVH()
+    // map the file and check validity
+    MappedFile file;
+    if (!file.Open(fileName))
+        return false;
+    // the mapping only needs to live as long as the parse
+    return ReadBVHText(file.View());
+} // ReadFileBVH()
+
+// open a bvh file for streaming
+bool BVHData::ReadFileBVHStreaming(const char *fileName, int chunkFrames, int residentChunks)
+{ // ReadFileBVHStreaming()
+    std::shared_ptr<BVHStream> stream = std::make_shared<BVHStream>(chunkFrames, residentChunks);
+    if (!stream->Open(fileName, *this))
+        return false;
+    // the file may hold fewer frames than its header claims
+    this->frame_count = stream->FrameCount();
+    this->motionStream = stream;
+    this->compressedMotion.reset();
+    ExtractRootMotion();
+    NewSerial();
+    return true;
+} // ReadFileBVHStreaming()
+
+// read data from bvh text that is already in memory
+// a basic recursive-descent parser
+bool BVHData::ReadBVHText(std::string_view text, size_t *motionOffset)
+{ // ReadBVHText()
+    // a tokeniser over the whole text
+    BVHTokenizer tokenizer(text);
+    // a vector of the tokens on the line, as views into the text
+    std::vector<std::string_view> tokens;
+
+    // loop through the text one non-empty line at a time
+    while (tokenizer.NextLine(tokens)) { // more lines in the text
+        // if the first token is HIERARCHY, it is the logical structure of the character
+        if (tokens[0] == "HIERARCHY") { // hierarchy
+            // read in a line and split it into tokens
+            tokenizer.NextLine(tokens);
+            // read in the hierarchy based at the root
+            ReadHierarchy(tokenizer, tokens, -1);
+        } // hierarchy
+        // otherwise, if the first token is MOTION, it is the animation data
+        else if (tokens[0] == "MOTION") { // motion
+            if (motionOffset != nullptr) { // header only
+                ReadMotionHeader(tokenizer);
+                *motionOffset = tokenizer.Offset();
+            } // header only
+            else
+                ReadMotion(tokenizer);
+            break;
+        }      // motion
+        else { // otherwise
+            // ignore everything else
+        } // otherwise
+    } // more lines in the text
+
+    // a file without a hierarchy is not a bvh file
+    if (this->skeleton.JointCount() == 0)
+        return false;
+
+    // load all rotation data into this class (a streamed clip decodes its own)
+    if (motionOffset == nullptr)
+        loadAllData();
+    return true;
+} // ReadBVHText()
+
+// recursive descent parser for the hierarchy
+void BVHData::ReadHierarchy(BVHTokenizer &tokenizer,
+                            std::vector<std::string_view> &line,
+                            int parent)
+{ // ReadHierarchy()
+    // the second token (#1) will be the name of the joint, which gets the next available ID
+    int id = this->skeleton.AddJoint(std::string(line.size() > 1 ? line[1] : std::string_view()), parent);
+    // read in the next line & tokenise it
+    if (!tokenizer.NextLine(line))
+        return;
+    // if the beginning of the line is a left brace, we're starting a group of children
+    if (line[0] == "{") { // group of children
+        // ignore the rest of the line and read in a new one
+        if (!tokenizer.NextLine(line))
+            return;
+        while (line[0] != "}") { // until we hit the close of the group
+            // OFFSET is the offset from the parent
+            if (line[0] == "OFFSET" && line.size() >= 4) {
+                this->skeleton.offset[id] = Cartesian3(BVHTokenizer::ToFloat(line[1]),
+                                                       BVHTokenizer::ToFloat(line[2]),
+                                                       BVHTokenizer::ToFloat(line[3]));
+            }
+            // CHANNELS defines how many floats are needed for the animation, and which ones
+            else if (line[0] == "CHANNELS" && line.size() >= 2) { // channel information
+                int nChannels = BVHTokenizer::ToInt(line[1]);
+                for (int i = 0; i < nChannels && i + 2 < (int) line.size(); i++)
+                    this->skeleton.AddChannel(ChannelId(line[i + 2]));
+            } // channel information
+            // JOINT defines a new joint
+            else if (line[0] == "JOINT") { // joint information
+                ReadHierarchy(tokenizer, line, id);
+            } // joint information
+            // At the leaf of the hierarchy, there is no joint. Instead it says End
+            else if (line[0] == "End") { // end site
+                // read in and ignore three extra lines
+                for (int i = 0; i < 3; i++)
+                    tokenizer.NextLine(line);
+            } // end site
+            // always read the next line when done processing this line
+            if (!tokenizer.NextLine(line))
+                return;
+        } // until we hit the close of the group
+    }     // group of children
+} // ReadHierarchy()
+
+// read the frame count and frame time that start the motion section
+void BVHData::ReadMotionHeader(BVHTokenizer &tokenizer)
+{ // ReadMotionHeader()
+    // the tokens on a header line
+    std::vector<std::string_view> tokens;
+    // the next line should specify how many frames, so read it in
+    tokenizer.NextLine(tokens);
+    // convert to an integer and save
+    this->frame_count = tokens.size() > 1 ? BVHTokenizer::ToInt(tokens[1]) : 0;
+    // the next line should specify how many seconds per frame, so read it in
+    tokenizer.NextLine(tokens);
+    // and convert it to a float
+    this->frame_time = tokens.size() > 2 ? BVHTokenizer::ToFloat(tokens[2]) : 0.0f;
+} // ReadMotionHeader()
+
+// read motion(frames) from memory
+void BVHData::ReadMotion(BVHTokenizer &tokenizer)
+{ // ReadMotion()
+    // the frame count and frame time come first
+    ReadMotionHeader(tokenizer);
+    // every frame has one float per channel of the skeleton
+    size_t channelCount = this->skeleton.ChannelCount();
+    if (channelCount == 0)
+        return;
+    // we know how many frames to expect, so allocate the whole block once
+    size_t capacity = this->frame_count > 0 ? this->frame_count : 1;
+    this->channelData.Resize(capacity * channelCount);
+    // after that, we loop until the end of the text
+    size_t frame = 0;
+    while (!tokenizer.AtEnd()) { // more data
+        // the header undercounted, so grow the block
+        if (frame == capacity) {
+            capacity *= 2;
+            this->channelData.Resize(capacity * channelCount);
+        }
+        // parse the numbers straight out of the text into their place in the block
+        if (tokenizer.NextFloats(&this->channelData[frame * channelCount], channelCount) < 0)
+            break;
+        frame++;
+    } // more data
+    // trust the frames actually read over the count in the header
+    this->channelData.Resize(frame * channelCount);
+    this->frame_count = frame;
+} // ReadMotion()
+
+// the original stream-based reader, kept as a reference for benchmarking
+bool BVHData::ReadFileBVHStream(const char *fileName)
+{ // ReadFileBVHStream()
     // open a file stream and check validity
     std::ifstream inFile(fileName);
     if (inFile.bad())
@@ -30,12 +228,8 @@ bool BVHData::ReadFileBVH(const char *fileName)
             if (tokens[0] == "HIERARCHY") { // hierarchy
                 // read in a line and split it into tokens
                 NewLine(inFile, tokens);
-                // create a joint object
-                Joint joint;
-                // read in the hierarchy based at the joint
-                ReadHierarchy(inFile, tokens, joint, -1);
-                // and set it to be the root
-                this->root = joint;
+                // read in the hierarchy based at the root
+                ReadHierarchy(inFile, tokens, -1);
             } // hierarchy
             // otherwise, if the first token is MOTION, it is the animation data
             else if (tokens[0] == "MOTION") { // motion
@@ -48,12 +242,10 @@ bool BVHData::ReadFileBVH(const char *fileName)
         }     // non-empty line
     }         // more lines in the file
 
-    // do a recursive search to set up the vector of pointers to the joints
-    GetAllJoints(this->root, this->all_joints);
-    // load all rotation and translation data into this class
-    loadAllData(this->boneRotations, this->boneTranslations, this->frames);
+    // load all rotation data into this class
+    loadAllData();
     return true;
-} // ReadFileBVH()
+} // ReadFileBVHStream()
 
 // read a single line and tokenise it
 void BVHData::NewLine(std::ifstream &inFile, std::vector<std::string> &tokens)
@@ -100,20 +292,10 @@ bool BVHData::isNumeric(const std::string &str)
 // recursive descent parser for the hierarchy
 void BVHData::ReadHierarchy(std::ifstream &inFile,
                             std::vector<std::string> &line,
-                            Joint &joint,
                             int parent)
 { // ReadHierarchy()
-    // the new joint will have the next available ID
-    // (0 offset means that it will be equal to the existing size)
-    joint.id = this->Bones.size();
-    // the second token (#1) will be the name of the joint
-    joint.joint_name = line[1];
-    // add the name to the list
-    this->Bones.push_back(joint.joint_name);
-    // and set the parent bone
-    this->parentBones.push_back(parent);
-    // this seems redundant, but removing it crashes. This works. For now.
-    int id = this->parentBones.size() - 1;
+    // the second token (#1) will be the name of the joint, which gets the next available ID
+    int id = this->skeleton.AddJoint(line[1], parent);
     // read in the next line & tokenise it
     NewLine(inFile, line);
     // if the beginning of the line is a left brace, we're starting a group of children
@@ -124,20 +306,16 @@ void BVHData::ReadHierarchy(std::ifstream &inFile,
             // The first token tells us which type of line
             // OFFSET is the offset from the parent
             if (line[0] == "OFFSET") {
-                joint.joint_offset[0] = std::stof(line[1]);
-                joint.joint_offset[1] = std::stof(line[2]);
-                joint.joint_offset[2] = std::stof(line[3]);
+                this->skeleton.offset[id] = Cartesian3(std::stof(line[1]), std::stof(line[2]), std::stof(line[3]));
             }
             // CHANNELS defines how many floats are needed for the animation, and which ones
             else if (line[0] == "CHANNELS") { // channel information
                 for (int i = 0; i < std::stoi(line[1]); i++)
-                    joint.joint_channel.push_back(line[i + 2]);
+                    this->skeleton.AddChannel(ChannelId(line[i + 2]));
             } // channel information
             // JOINT defines a new joint
             else if (line[0] == "JOINT") { // joint information
-                Joint child;
-                ReadHierarchy(inFile, line, child, id);
-                joint.Children.push_back(child);
+                ReadHierarchy(inFile, line, id);
             } // joint information
             // At the leaf of the hierarchy, there is no joint. Instead it says End
             else if (line[0] == "End") { // end site
@@ -166,54 +344,140 @@ void BVHData::ReadMotion(std::ifstream &inFile)
     NewLine(inFile, tokens);
     // and convert it to a float
     this->frame_time = std::stof(tokens[2]);
+    // all the animation data, frame after frame
+    std::vector<float> frames;
     // after that, we loop until the end of the file
     while (std::getline(inFile, line)) { // more data
         // ignore empty lines
         if (line.size() != 0) { // non-empty line
             // split the line into tokens
             StringSplit(line, tokens);
-            // create a vector to store all the animation data for the frame
-            std::vector<float> frame;
             // loop through the line, one token at a time
             for (size_t i = 0; i < tokens.size(); i++) { // per token
                 if (!isNumeric(tokens[i])) {             // if it's not numeric
-                    frame.push_back(std::stof(tokens[i]));
+                    frames.push_back(std::stof(tokens[i]));
                 } // if it's not numeric
             }     // per token
-            // store frame into this class
-            this->frames.push_back(frame);
         }
     } // more data
+    // store the frames into this class
+    size_t channelCount = this->skeleton.ChannelCount();
+    this->frame_count = channelCount == 0 ? 0 : frames.size() / channelCount;
+    this->channelData.Resize(this->frame_count * channelCount);
+    if (!this->channelData.Empty())
+        memcpy(this->channelData.Data(), frames.data(), this->channelData.Size() * sizeof(float));
 } // ReadMotion()
 
-// render hierarchy for a given frame
-void BVHData::Render(Matrix4 &viewMatrix, float scale, int frame)
-{ // Render()
-    RenderJoint(viewMatrix, Matrix4::Identity(), &this->root, scale, frame);
-} // Render()
+// rotation of a joint at a given frame, wherever the clip stores it
+const Cartesian3 &BVHData::JointRotation(int frame, int joint) const
+{ // JointRotation()
+    if (compressedMotion)
+        return compressedMotion->Frame(frame)[joint];
+    if (motionStream)
+        return motionStream->Frame(frame)[joint];
+    return rotationTrack[(size_t) frame * skeleton.JointCount() + joint];
+} // JointRotation()
+
+// position of the root at a given frame, wherever the clip stores it
+const Cartesian3 &BVHData::RootPosition(int frame) const
+{ // RootPosition()
+    if (compressedMotion)
+        return compressedMotion->RootPosition(frame);
+    if (motionStream)
+        return motionStream->RootPosition(frame);
+    return rootPositionTrack[frame];
+} // RootPosition()
+
+// rotation of a joint at a given frame as a quaternion
+const Quaternion &BVHData::JointQuaternion(int frame, int joint) const
+{ // JointQuaternion()
+    return FrameQuaternions(frame)[joint];
+} // JointQuaternion()
+
+// rotations of every joint at a given frame as quaternions, in joint order
+const Quaternion *BVHData::FrameQuaternions(int frame) const
+{ // FrameQuaternions()
+    if (compressedMotion)
+        return compressedMotion->Quaternions(frame);
+    if (motionStream)
+        return motionStream->Quaternions(frame);
+    return &quaternionTrack[(size_t) frame * skeleton.JointCount()];
+} // FrameQuaternions()
+
+// root motion from a given frame to the next
+const RootMotionDelta &BVHData::RootMotion(int frame) const
+{ // RootMotion()
+    return rootMotionTrack[frame];
+} // RootMotion()
+
+// heading of the root about the vertical axis for a pose, in degrees
+float BVHData::RootHeading(const Quaternion *rotations) const
+{ // RootHeading()
+    // the way the root faces, as EvaluatePose turns it
+    Cartesian3 forward = rotations[0].Rotate(Cartesian3(0.0f, 0.0f, 1.0f));
+    // RotateY(heading) turns +z to this direction
+    return (float) (atan2(-forward.x, forward.z) * 180.0 / M_PI);
+} // RootHeading()
+
+// fill rootMotionData with the motion over the ground of every frame
+void BVHData::ExtractRootMotion()
+{ // ExtractRootMotion()
+    rootMotionData.Resize(frame_count);
+    rootMotionTrack = rootMotionData.Data();
+    if (frame_count < 2 || skeleton.JointCount() == 0)
+        return;
+
+    Pose pose, nextPose;
+    EvaluateFrame(*this, 0, pose);
+    for (int frame = 0; frame + 1 < frame_count; frame++) { // per frame
+        EvaluateFrame(*this, frame + 1, nextPose);
+        // the lowest joint is taken to be planted: move the root with the root channels,
+        // less however far that joint would otherwise slide
+        int planted = 0;
+        for (int joint = 1; joint < pose.JointCount(); joint++)
+            if (pose.ClipPosition(joint).y < pose.ClipPosition(planted).y)
+                planted = joint;
+        Cartesian3 step = (nextPose.rootPosition - pose.rootPosition)
+                          - (nextPose.ClipPosition(planted) - pose.ClipPosition(planted));
+        // only the movement over the ground: the terrain sets the height
+        rootMotionData[frame].translation = Cartesian3(step.x, 0.0f, step.z);
+        rootMotionData[frame].yaw = 0.0f;
+        std::swap(pose, nextPose);
+    } // per frame
 
-// render a single joint for a given frame
-void BVHData::RenderJoint(
-    Matrix4 &viewMatrix, Matrix4 parentMatrix, Joint *joint, float scale, int frame)
-{ // RenderJoint()
-
-    // get the rotation of the current joint
-    Cartesian3 jointRotation = boneRotations[frame][joint->id];
-    //create a rotation matrix from the euler angles
-    Matrix4 rotation = Matrix4::RotateZ(jointRotation.z) * Matrix4::RotateY(jointRotation.y)
-                       * Matrix4::RotateX(jointRotation.x);
-    //get the offset from the root bone
-    Cartesian3 offsetFromRoot = parentMatrix.column(3).Vector();
-    // Transform the current joint offset based on frame and scale
-    Cartesian3 jointOffset = boneTranslations[joint->id] * scale;
-    //update the parentMatrix for the next function call by the translate and the inverse of the rotation (as the matrix should be column major)
-    parentMatrix = parentMatrix * Matrix4::Translate(jointOffset) * rotation.transpose();
-
-    //dont render the root bone
-    if (joint->id > 0) {
+    // the clip then starts again from its first frame, which faces the way the first
+    // frame faced, so the character takes on the turn the clip made
+    float lastHeading = RootHeading(FrameQuaternions(frame_count - 1));
+    float turn = lastHeading - RootHeading(FrameQuaternions(0));
+    while (turn > 180.0f)
+        turn -= 360.0f;
+    while (turn <= -180.0f)
+        turn += 360.0f;
+    rootMotionData[frame_count - 1].translation = Cartesian3(0.0f, 0.0f, 0.0f);
+    rootMotionData[frame_count - 1].yaw = turn;
+} // ExtractRootMotion()
+
+// rotations of every joint at a given frame, in joint order
+const Cartesian3 *BVHData::FrameRotations(int frame) const
+{ // FrameRotations()
+    return &JointRotation(frame, 0);
+} // FrameRotations()
+
+// render the skeleton in a pose already evaluated for it
+void BVHData::Render(Matrix4 &viewMatrix, float scale, const Pose &pose) const
+{ // Render()
+    // the pose is in the clip's units, so the bones are scaled as they are drawn
+    //multiply by the inverse of the world2OpenglMatrix to have the character correctly oriented
+    //(the same for every bone, so it is built once)
+    Matrix4 uprightView = viewMatrix * Matrix4::RotateX(-90.0);
+    for (int joint = 0; joint < pose.JointCount(); joint++) { // per joint
+        //dont render the root bone
+        int parent = skeleton.parent[joint];
+        if (parent < 0)
+            continue;
         //set the start and end
-        Cartesian3 start = offsetFromRoot;
-        Cartesian3 end = parentMatrix.column(3).Vector();
+        Cartesian3 start = pose.Position(parent) * scale;
+        Cartesian3 end = pose.Position(joint) * scale;
 
         Cartesian3 z = Cartesian3(0, 0, 1);
         //find the rotation between the vector that describes the bone and the z axis vector
@@ -222,28 +486,20 @@ void BVHData::RenderJoint(
         //rotate the cylinder at the joint
         Matrix4 cylinderTransform = Matrix4::Translate(start) * rotation2;
 
-        //multiply by the inverse of the world2OpenglMatrix to have the character correctly oriented
-        Matrix4 finalTransform = viewMatrix * Matrix4::RotateX(-90.0) * cylinderTransform;
+        Matrix4 finalTransform = uprightView * cylinderTransform;
         // Render bone as a cylinder
         RenderCylinder(finalTransform, start, end);
-    }
-    //    currRotation = currRotation * rotation;
-    // parentMatrix = parentMatrix * rotation;
-    // Render children recursively
-    for (size_t i = 0; i < joint->Children.size(); i++) {
-        RenderJoint(viewMatrix, parentMatrix, &(joint->Children[i]), scale, frame);
-    }
-
-} // RenderJoint()
+    } // per joint
+} // Render()
 
 // render cylinder given the start position and the end position
-void BVHData::RenderCylinder(Matrix4 &viewMatrix, Cartesian3 start, Cartesian3 end)
+void BVHData::RenderCylinder(Matrix4 &viewMatrix, Cartesian3 start, Cartesian3 end) const
 { // RenderCylinder()
     this->Cylinder(viewMatrix, 0.05f, (end - start).length(), 10);
 } // RenderCylinder()
 
 // render a single cylinder given radius, length and vertical slices
-void BVHData::Cylinder(Matrix4 &viewMatrix, float radius, float Length, int slices)
+void BVHData::Cylinder(Matrix4 &viewMatrix, float radius, float Length, int slices) const
 { // Cylinder()
     // start a set of triangles
     glBegin(GL_TRIANGLES);
@@ -312,57 +568,126 @@ void BVHData::Cylinder(Matrix4 &viewMatrix, float radius, float Length, int slic
     glEnd();
 } // Cylinder()
 
-// get all joints in a sequence by searching the tree structure and store it into this class
-void BVHData::GetAllJoints(Joint &joint, std::vector<Joint *> &joint_list)
-{ // GetAllJoints()
-    // it's recursive, so push the current one
-    joint_list.push_back(&joint);
-    // base case: end site, so return
-    if (joint.Children.size() == 0)
-        return;
-    // otherwise, loop through the children
-    for (size_t i = 0; i < joint.Children.size(); i++)
-        // adding them recursively
-        GetAllJoints(joint.Children[i], joint_list);
-} // GetAllJoints()
-
-// load all rotation and translation data into this class
-void BVHData::loadAllData(std::vector<std::vector<Cartesian3>> &rotations,
-                          std::vector<Cartesian3> &translations,
-                          std::vector<std::vector<float>> &frames)
+// load all rotation data into this class
+void BVHData::loadAllData()
 { // loadAllData()
-    // store all rotations
-    for (size_t i = 0; i < frames.size(); i++) { // per frame
-        std::vector<Cartesian3> frame_rotations;
-        loadRotationData(frame_rotations, frames[i]);
-        rotations.push_back(frame_rotations);
-    } // per frame
-    // store all offsets/translations
-    for (size_t i = 0; i < this->all_joints.size(); i++) { // per joint
-        float x = this->all_joints[i]->joint_offset[0];
-        float y = this->all_joints[i]->joint_offset[1];
-        float z = this->all_joints[i]->joint_offset[2];
-        translations.push_back(Cartesian3(x, y, z));
-    } // per joint
+    // one block for the rotations of every frame, and one for the root's path
+    size_t jointCount = skeleton.JointCount();
+    size_t channelCount = skeleton.ChannelCount();
+    rotationData.Resize(frame_count * jointCount);
+    rootPositionData.Resize(frame_count);
+    // decode every frame through the skeleton's decode table
+    for (int i = 0; i < frame_count; i++) // per frame
+        skeleton.DecodeFrame(&channelData[i * channelCount], &rotationData[i * jointCount], rootPositionData[i]);
+    rotationTrack = rotationData.Data();
+    rootPositionTrack = rootPositionData.Data();
+    // and convert them to quaternions, so that playing them needs no trigonometry
+    quaternionData.Resize(frame_count * jointCount);
+    skeleton.ConvertRotations(rotationTrack, quaternionData.Data(), frame_count);
+    quaternionTrack = quaternionData.Data();
+    compressedMotion.reset();
+    poseCache.reset();
+    gait.reset();
+    ExtractRootMotion();
+    NewSerial();
 } // loadAllData()
 
-// load all rotation data into this class
-void BVHData::loadRotationData(std::vector<Cartesian3> &rotations, std::vector<float> &frames)
-{                                                           // loadRotationData()
-    for (size_t j = 0, j_c = 0; j < frames.size(); j_c++) { // per frame
-        float rotation[3] = {0, 0, 0};
-        for (size_t k = 0; k < this->all_joints[j_c]->joint_channel.size(); k++) // for each channel
-        {                                                                        // per channel
-            // if the channel includes "rotation" in the name
-            if (this->all_joints[j_c]->joint_channel[k].substr(1)
-                == "rotation") { // rotation channel
-                int rotation_id = BVH_CHANNEL[this->all_joints[j_c]->joint_channel[k]];
-                rotation[rotation_id - 3] = frames[j + k];
-            } // rotation channel
-        }     // per channel
-        // convert to a rotation
-        Cartesian3 rot_3(rotation[0], rotation[1], rotation[2]);
-        rotations.push_back(rot_3);
-        j += this->all_joints[j_c]->joint_channel.size();
-    } // per frame
-} // loadRotationData()
+// replace the frame data with an error-bounded compressed copy
+void BVHData::Compress(float maxError)
+{ // Compress()
+    std::shared_ptr<CompressedClip> compressed = std::make_shared<CompressedClip>();
+    compressed->Compress(*this, maxError);
+    // the compressed copy now holds every frame, so nothing else needs to
+    compressedMotion = compressed;
+    motionStream.reset();
+    // the poses move (by up to maxError), so any that were cached are dropped
+    poseCache.reset();
+    channelData.Clear();
+    rotationData.Clear();
+    quaternionData.Clear();
+    rootPositionData.Clear();
+    rotationTrack = nullptr;
+    quaternionTrack = nullptr;
+    rootPositionTrack = nullptr;
+    NewSerial();
+} // Compress()
+
+// resample every track to a new frame time
+void BVHData::Resample(float frameTime)
+{ // Resample()
+    if (frameTime <= 0.0f || frame_time <= 0.0f || frame_count == 0)
+        return;
+    // bvh files round the frame time (24 fps is written 0.041667), which is not a new rate
+    if (fabsf(frame_time - frameTime) <= 1.0e-3f * frameTime) {
+        frame_time = frameTime;
+        return;
+    }
+    size_t jointCount = skeleton.JointCount();
+    int count = (int) floorf((frame_count - 1) * frame_time / frameTime + 1.0e-3f) + 1;
+    AlignedBuffer<Quaternion> quaternions;
+    AlignedBuffer<Cartesian3> rotations, rootPositions;
+    quaternions.Resize((size_t) count * jointCount);
+    rotations.Resize((size_t) count * jointCount);
+    rootPositions.Resize(count);
+
+    // the two old frames either side of a new one, copied out because a streamed or
+    // compressed clip decodes each frame into the same buffer
+    std::vector<Quaternion> beforeQuaternions(jointCount);
+    std::vector<Cartesian3> beforeRotations(jointCount);
+    for (int frame = 0; frame < count; frame++) { // per new frame
+        float position = std::min(frame * frameTime / frame_time, (float) (frame_count - 1));
+        int before = std::min((int) floorf(position), frame_count - 1);
+        int after = std::min(before + 1, frame_count - 1);
+        float t = position - before;
+        std::copy(FrameQuaternions(before), FrameQuaternions(before) + jointCount, beforeQuaternions.begin());
+        std::copy(FrameRotations(before), FrameRotations(before) + jointCount, beforeRotations.begin());
+        Cartesian3 beforeRoot = RootPosition(before);
+        const Quaternion *afterQuaternions = FrameQuaternions(after);
+        for (size_t joint = 0; joint < jointCount; joint++)
+            quaternions[frame * jointCount + joint] = Quaternion::Slerp(beforeQuaternions[joint], afterQuaternions[joint], t);
+        const Cartesian3 *afterRotations = FrameRotations(after);
+        for (size_t joint = 0; joint < jointCount; joint++) { // per joint
+            Cartesian3 &rotation = rotations[frame * jointCount + joint];
+            for (int axis = 0; axis < 3; axis++) { // per axis
+                // the shorter way round, as the quaternions go
+                float turn = afterRotations[joint][axis] - beforeRotations[joint][axis];
+                turn -= 360.0f * floorf((turn + 180.0f) / 360.0f);
+                rotation[axis] = beforeRotations[joint][axis] + turn * t;
+            } // per axis
+        } // per joint
+        rootPositions[frame] = beforeRoot * (1.0f - t) + RootPosition(after) * t;
+    } // per new frame
+
+    // the clip now holds its frames in memory, at the new rate
+    rotationData = std::move(rotations);
+    quaternionData = std::move(quaternions);
+    rootPositionData = std::move(rootPositions);
+    rotationTrack = rotationData.Data();
+    quaternionTrack = quaternionData.Data();
+    rootPositionTrack = rootPositionData.Data();
+    motionStream.reset();
+    compressedMotion.reset();
+    poseCache.reset();
+    gait.reset();
+    // the raw channels are left at the old rate, so they go
+    channelData.Clear();
+    frame_count = count;
+    frame_time = frameTime;
+    ExtractRootMotion();
+    NewSerial();
+} // Resample()
+
+// keep the model-space poses of up to maxBytes' worth of frames
+void BVHData::CachePoses(size_t maxBytes, bool bake)
+{ // CachePoses()
+    std::shared_ptr<PoseCache> cache = std::make_shared<PoseCache>(*this, maxBytes);
+    if (bake)
+        cache->Bake(*this);
+    poseCache = cache;
+} // CachePoses()
+
+// find the foot contacts and stride phase of every frame
+void BVHData::AnnotateGait()
+{ // AnnotateGait()
+    gait = std::make_shared<GaitTrack>(*this);
+} // AnnotateGait()
@@ -28,100 +28,215 @@
 #endif
 
 #include <vector>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include "Cartesian3.h"
 #include "Matrix4.h"
+#include "Quaternion.h"
+#include "AlignedBuffer.h"
+#include "BVHTokenizer.h"
+#include "Skeleton.h"
 #include <fstream>
 #include <map>
 #include <math.h>
 
-// A class for each joint
-class Joint
-	{ // class Joint
-	public:
-	// joint id
-	int id;
-	// joint name
-	std::string joint_name;
-	// joint offset
-	float joint_offset[3] = {0.0f, 0.0f, 0.0f};
-	// joint channel
-	std::vector<std::string> joint_channel;
-	// joint's children
-	std::vector<Joint> Children;
-	}; // class Joint
+// frames decoded on demand from a bvh file (see BVHStream.h)
+class BVHStream;
+// frames decoded from an error-bounded compressed copy (see CompressedClip.h)
+class CompressedClip;
+// joint transforms evaluated for one pose (see Pose.h)
+class Pose;
+// model-space joint transforms kept for a clip's frames (see PoseCache.h)
+class PoseCache;
+// foot contacts and stride phase of a clip's frames (see GaitTrack.h)
+class GaitTrack;
+
+// how far the root moves over one frame of a clip, extracted at load so that the
+// character can be moved by the clip itself
+struct RootMotionDelta
+	{ // struct RootMotionDelta
+	// movement over the ground from this frame to the next, in the clip's space
+	Cartesian3 translation;
+	// turn about the vertical axis in degrees, applied after the frame: nonzero only
+	// on the last frame, where it carries the heading from the end of the clip on
+	// into the start of the next loop
+	float yaw;
+	}; // struct RootMotionDelta
 
 // bvh data class
 class BVHData
 	{ // class BVHData
 	public:
 
-	// the root joint of armature
-	Joint root;
+	// the armature: joints in depth-first order, with their parents, offsets
+	// from the parent, channel layout and names (see Skeleton.h)
+	Skeleton skeleton;
+
+	// a number no other clip has, which changes whenever this clip's skeleton or frames
+	// are replaced (by loading, resampling, compressing or binding it): a pose remembers
+	// it rather than the clip's address, which a later clip may reuse
+	unsigned long long serial = 0;
 
 	// bvh frame count
-	int frame_count;
+	int frame_count = 0;
 
 	// frame rate of the animation
-	float frame_time;
+	float frame_time = 0.0f;
 
-	// a vector to store all bones' name
-	std::vector<std::string> Bones;
+	// all frames of the animation in one aligned block
+	// this is *JUST* a huge 2D array of floats: frame n starts at
+	// channelData[n * skeleton.ChannelCount()], with the channels of each joint
+	// listed in strict numerical order
+	AlignedBuffer<float> channelData;
 
-	// a vector to store all joints
-	std::vector<Joint*> all_joints;
+	// all bones' rotations for each frame in one aligned block, frame-major with
+	// one per joint: frame n starts at rotationData[n * skeleton.JointCount()]
+	AlignedBuffer<Cartesian3> rotationData;
 
-	// a vector to store the parent bone's id for each joint
-	std::vector<int> parentBones;
+	// the same rotations as unit quaternions, converted once at load in each joint's
+	// channel order and indexed like rotationData; this is what is played and blended
+	AlignedBuffer<Quaternion> quaternionData;
 
-	// a vector to store all frames of the animation
-	// this is *JUST* a huge 2D array of floats
-	// in each frame, we have six channels for position and rotation for each joint
-	// listed in strict numerical order
-	std::vector<std::vector<float>> frames;
+	// the root's position channels for each frame (zero where it has none)
+	AlignedBuffer<Cartesian3> rootPositionData;
+
+	// the root motion over each frame (see ExtractRootMotion)
+	AlignedBuffer<RootMotionDelta> rootMotionData;
+
+	// the rotations actually played: rotationData, or the pages of a mapped
+	// animation database (nullptr for a streamed clip)
+	const Cartesian3 *rotationTrack = nullptr;
+
+	// the quaternions actually played: quaternionData, or a mapped database
+	const Quaternion *quaternionTrack = nullptr;
+
+	// the root positions actually played, from the same place as rotationTrack
+	const Cartesian3 *rootPositionTrack = nullptr;
+
+	// the root motion actually played: rootMotionData, or a mapped database
+	const RootMotionDelta *rootMotionTrack = nullptr;
 
-	// a vector to store all bones' offsets
-	std::vector<Cartesian3> boneTranslations;
+	// frames of a clip opened for streaming, decoded on demand in a bounded window
+	// (empty when the frames are held in memory; each thread decodes into its own
+	// window, and decoding only changes which frames are resident, so it is allowed
+	// through a const clip)
+	std::shared_ptr<BVHStream> motionStream;
 
-	// a vector to store all bones' rotations for each frame
-	std::vector<std::vector<Cartesian3>> boneRotations;
+	// the tracks of a clip that has been compressed, decoded a frame at a time
+	// (empty unless Compress has been called; it decodes into a cache per thread, so
+	// it may be played from several threads at once)
+	std::shared_ptr<CompressedClip> compressedMotion;
+
+	// the model-space poses of frames already evaluated, so that a looping clip skips
+	// forward kinematics on later loops (empty unless CachePoses has been called;
+	// filled as frames are played, safely from several threads)
+	std::shared_ptr<PoseCache> poseCache;
+
+	// which feet are planted on each frame, and how far through its stride each frame
+	// is (empty unless AnnotateGait has been called)
+	std::shared_ptr<const GaitTrack> gait;
 	
 private:
 	// id for each channel
-	std::map<std::string, int> BVH_CHANNEL =
-		{ // BVH_CHANNEL
-			{"Xposition", 0},
-			{"Yposition", 1},
-			{"Zposition", 2},
-			{"Xrotation", 3},
-			{"Yrotation", 4},
-			{"Zrotation", 5}
-		}; // BVH_CHANNEL
+	static const std::map<std::string, int, std::less<>> BVH_CHANNEL;
+
+	// id of a named channel, or -1 if it is not one we know
+	static int ChannelId(std::string_view channelName);
 
 public:
 	// constructor
 	BVHData();
 
-	// render bvh animation by given a sequence of frames data
-	void Render(Matrix4& viewMatrix, float scale, int frame);
+	// a loaded clip is an immutable asset shared through ClipHandle, so it is never copied
+	BVHData(const BVHData&) = delete;
+	BVHData& operator=(const BVHData&) = delete;
+
+	// give the clip a new serial, after its skeleton or frames have been replaced
+	void NewSerial();
+
+	// rotation of a joint at a given frame, wherever the clip stores it
+	const Cartesian3 &JointRotation(int frame, int joint) const;
+
+	// position of the root at a given frame, wherever the clip stores it
+	const Cartesian3 &RootPosition(int frame) const;
+
+	// rotations of every joint at a given frame, in joint order
+	const Cartesian3 *FrameRotations(int frame) const;
+
+	// rotation of a joint at a given frame as a quaternion
+	const Quaternion &JointQuaternion(int frame, int joint) const;
+
+	// rotations of every joint at a given frame as quaternions, in joint order
+	const Quaternion *FrameQuaternions(int frame) const;
+
+	// root motion from a given frame to the next
+	const RootMotionDelta &RootMotion(int frame) const;
+
+	// heading of the root about the vertical axis for a pose, in degrees
+	float RootHeading(const Quaternion *rotations) const;
+
+	// fill rootMotionData with the motion over the ground of every frame
+	// the skeleton is drawn relative to its root, so each step is the one that keeps
+	// the lowest joint (the planted foot) still on the ground; clips captured in place
+	// travel at their true speed, and no clip's feet skate
+	void ExtractRootMotion();
+
+	// replace the frame data with an error-bounded compressed copy (see CompressedClip)
+	// keys are dropped while no joint moves more than maxError; the raw buffers are freed
+	void Compress(float maxError);
+
+	// resample every track to a new frame time, so that clips from different rigs
+	// share one time base: the new frames span the same time from the first frame to
+	// the last, the rotations slerped between the old frames and the root positions
+	// lerped (the Euler angles kept for the tools are interpolated one channel at a
+	// time, so between the old frames they only approximate the quaternions); a
+	// streamed or compressed clip is decoded into memory, and a clip already at the
+	// rate (up to the rounding of the file) only has its frame time set to it
+	void Resample(float frameTime);
+
+	// keep the model-space poses of up to maxBytes' worth of frames (see PoseCache),
+	// evaluating them all now if bake is set, otherwise as each is first played
+	void CachePoses(size_t maxBytes, bool bake);
+
+	// find the foot contacts and stride phase of every frame (see GaitTrack)
+	void AnnotateGait();
+
+	// render the skeleton in a pose already evaluated for it (see Pose.h)
+	void Render(Matrix4& viewMatrix, float scale, const Pose &pose) const;
 
-	// render a single joint by given frame id
-	void RenderJoint(Matrix4& viewMatrix, Matrix4 HierarchicalMatrix, Joint* joint, float scale, int frame);
 
 	// render cylinder given the start position and the end position
-	void RenderCylinder(Matrix4& viewMatrix, Cartesian3 start, Cartesian3 end);
+	void RenderCylinder(Matrix4& viewMatrix, Cartesian3 start, Cartesian3 end) const;
 
 	// render a single cylinder given radius, length and vertical slices
-	void Cylinder(Matrix4& viewMatrix, float radius, float halfLength, int slices);
-
-	// get all joints in a sequence by searching the tree structure and store it into this class
-	void GetAllJoints(Joint&, std::vector<Joint*>&);
+	void Cylinder(Matrix4& viewMatrix, float radius, float halfLength, int slices) const;
 
 	// Routines for file I/O
-	// read data from bvh file
+	// read data from bvh file (memory-mapped and tokenised in place)
 	bool ReadFileBVH(const char* fileName);
 
+	// open a bvh file for streaming: the hierarchy is read now, frames are decoded
+	// chunkFrames at a time as playback reaches them, keeping residentChunks in memory
+	bool ReadFileBVHStreaming(const char* fileName, int chunkFrames = 64, int residentChunks = 4);
+
+	// read data from bvh text that is already in memory
+	// if motionOffset is given, stop after the motion header and return where the frames start
+	bool ReadBVHText(std::string_view text, size_t *motionOffset = nullptr);
+
+	// recursive descent parser for the hierarchy, adding joints to the skeleton
+	void ReadHierarchy(BVHTokenizer&, std::vector<std::string_view>&, int parent);
+
+	// read motion(frames) from memory
+	void ReadMotion(BVHTokenizer&);
+
+	// read the frame count and frame time that start the motion section
+	void ReadMotionHeader(BVHTokenizer&);
+
+	// the original stream-based reader, kept as a reference for benchmarking
+	bool ReadFileBVHStream(const char* fileName);
+
 	// read a single line and tokenise it
 	void NewLine(std::ifstream&, std::vector<std::string>&);
 
@@ -129,26 +244,23 @@ public:
 	void StringSplit(std::string, std::vector<std::string>&);
 
 	// recursive descent parser for the hierarchy
-	void ReadHierarchy(std::ifstream&, std::vector<std::string>&, Joint&, int parent);
+	void ReadHierarchy(std::ifstream&, std::vector<std::string>&, int parent);
 
 	// read motion(frames) from file
 	void ReadMotion(std::ifstream&);
 
-	// load all rotation and translation data into this class
-	void loadAllData(std::vector<std::vector<Cartesian3>>& rotations, std::vector<Cartesian3>& translations, std::vector<std::vector<float>>& frames);
-
-	// load all rotation data into this class
-	void loadRotationData(std::vector<Cartesian3> &rotations, std::vector<float>& frames);
+	// decode all frames into the rotation and root position tracks
+	void loadAllData();
 
 	// check whether the given string is a number
     bool isNumeric(const std::string &);
-
-    void renderBlendedJoint(Matrix4 &viewMatrix,
-                            Matrix4 HierarchicalMatrix,
-                            Joint *joint,
-                            float scale,
-                            int frame,
-                            std::vector<std::vector<Cartesian3>> &rotations);
 };
 
+// a cheap, reference-counted handle to an immutable clip
+// switching clips or sharing one between characters copies only the handle
+typedef std::shared_ptr<const BVHData> ClipHandle;
+
+// the clips are y-up with z forward, the scene is z-up
+extern const Matrix4 clipToScene;
+
 #endif
@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	BVHStream.cpp
+//	------------------------
+//	
+//	Streams the MOTION section of a bvh file: frames are
+//	decoded a chunk at a time into a small ring of pages,
+//	so only a window around the playback cursor is held in
+//	memory however long the capture is. Each thread that
+//	reads the stream has its own cursor (its own ring), so
+//	readers never evict each other's frames.
+//	
+///////////////////////////////////////////////////
+
+#include "BVHStream.h"
+#include "BVHData.h"
+#include "BVHTokenizer.h"
+
+#include <cstring>
+
+// the id the last stream was given (0 is never given, so a thread that has read no
+// stream matches none)
+static std::atomic<unsigned long long> lastId(0);
+
+// chunkFrames frames are decoded at once, and residentChunks chunks are kept
+BVHStream::BVHStream(int ChunkFrames, int ResidentChunks)
+	: skeleton(nullptr),
+	id(++lastId),
+	frameCount(0),
+	jointCount(0),
+	chunkFrames(ChunkFrames < 1 ? 1 : ChunkFrames),
+	residentChunks(ResidentChunks < 1 ? 1 : ResidentChunks),
+	chunksDecoded(0)
+	{ // constructor
+	} // constructor
+
+// map the file, read its hierarchy into the clip, and index the frames
+bool BVHStream::Open(const char *fileName, BVHData &clip)
+	{ // Open()
+	if (!file.Open(fileName))
+		return false;
+	// parse the hierarchy and the motion header, but none of the frames
+	size_t motionOffset = file.Size();
+	if (!clip.ReadBVHText(file.View(), &motionOffset))
+		return false;
+
+	// rows are decoded through the clip's own decode table (the clip owns this stream)
+	skeleton = &clip.skeleton;
+	jointCount = skeleton->JointCount();
+
+	// build the seek index: one pass over the newlines, noting every chunkFrames-th row
+	const char *text = file.Data();
+	size_t position = motionOffset;
+	frameCount = 0;
+	chunkOffsets.clear();
+	while (position < file.Size())
+		{ // per line
+		const char *lineEnd = (const char *) memchr(text + position, '\n', file.Size() - position);
+		size_t next = lineEnd ? (size_t) (lineEnd - text) + 1 : file.Size();
+		// blank lines are not frames
+		bool blank = true;
+		for (size_t c = position; c < next && blank; c++)
+			blank = text[c] == ' ' || text[c] == '\t' || text[c] == '\r' || text[c] == '\n';
+		if (!blank)
+			{ // a frame
+			if (frameCount % chunkFrames == 0)
+				chunkOffsets.push_back(position);
+			frameCount++;
+			} // a frame
+		position = next;
+		} // per line
+	chunkOffsets.push_back(file.Size());
+	// a clip with no frames has nothing to stream
+	if (frameCount == 0)
+		return false;
+	// any cursor from an earlier file is rebuilt for this one
+	std::lock_guard<std::mutex> lock(cursorLock);
+	cursors.clear();
+	id = ++lastId;
+	return true;
+	} // Open()
+
+// number of frames in the file
+int BVHStream::FrameCount() const
+	{ // FrameCount()
+	return frameCount;
+	} // FrameCount()
+
+// rotations of every joint at a frame, decoding its chunk if it is not resident
+const Cartesian3 *BVHStream::Frame(int frame) const
+	{ // Frame()
+	Cursor &cursor = ThreadCursor();
+	return &cursor.pages[ResidentFrame(cursor, frame) * jointCount];
+	} // Frame()
+
+// the same rotations as quaternions
+const Quaternion *BVHStream::Quaternions(int frame) const
+	{ // Quaternions()
+	Cursor &cursor = ThreadCursor();
+	return &cursor.quaternionPages[ResidentFrame(cursor, frame) * jointCount];
+	} // Quaternions()
+
+// position of the root at a frame, decoding its chunk if it is not resident
+const Cartesian3 &BVHStream::RootPosition(int frame) const
+	{ // RootPosition()
+	Cursor &cursor = ThreadCursor();
+	return cursor.rootPages[ResidentFrame(cursor, frame)];
+	} // RootPosition()
+
+// the calling thread's cursor, made the first time it reads the stream
+BVHStream::Cursor &BVHStream::ThreadCursor() const
+	{ // ThreadCursor()
+	// a thread playing one stream finds its cursor without taking the lock
+	thread_local unsigned long long lastStream = 0;
+	thread_local Cursor *lastCursor = nullptr;
+	if (lastStream == id)
+		return *lastCursor;
+
+	std::lock_guard<std::mutex> lock(cursorLock);
+	std::thread::id self = std::this_thread::get_id();
+	Cursor *found = nullptr;
+	for (const std::unique_ptr<Cursor> &cursor : cursors)
+		if (cursor->thread == self)
+			found = cursor.get();
+	if (found == nullptr)
+		{ // new reader
+		// its ring of pages is allocated once, up front
+		std::unique_ptr<Cursor> cursor(new Cursor);
+		cursor->thread = self;
+		cursor->pages.assign((size_t) residentChunks * chunkFrames * jointCount, Cartesian3());
+		cursor->quaternionPages.assign(cursor->pages.size(), Quaternion());
+		cursor->rootPages.assign((size_t) residentChunks * chunkFrames, Cartesian3());
+		cursor->slotChunk.assign(residentChunks, -1);
+		cursor->row.assign(skeleton->ChannelCount(), 0.0f);
+		found = cursor.get();
+		cursors.push_back(std::move(cursor));
+		} // new reader
+	lastStream = id;
+	lastCursor = found;
+	return *found;
+	} // ThreadCursor()
+
+// index of a frame within a cursor's ring, decoding its chunk if it is not resident
+size_t BVHStream::ResidentFrame(Cursor &cursor, int frame) const
+	{ // ResidentFrame()
+	// clamp to the frames that exist
+	if (frame < 0)
+		frame = 0;
+	if (frame >= frameCount)
+		frame = frameCount - 1;
+	int chunk = frame / chunkFrames;
+	// consecutive chunks land in consecutive slots, so the ring holds a sliding window
+	int slot = chunk % residentChunks;
+	if (cursor.slotChunk[slot] != chunk)
+		DecodeChunk(cursor, chunk, slot);
+	return (size_t) slot * chunkFrames + frame % chunkFrames;
+	} // ResidentFrame()
+
+// decode a chunk of frames into a slot of a cursor's ring
+void BVHStream::DecodeChunk(Cursor &cursor, int chunk, int slot) const
+	{ // DecodeChunk()
+	// the text behind the evicted chunk will not be read again soon by this reader (and
+	// dropping it only means another reader faults it back in from the file)
+	int evicted = cursor.slotChunk[slot];
+	if (evicted >= 0)
+		file.Release(chunkOffsets[evicted], chunkOffsets[evicted + 1] - chunkOffsets[evicted]);
+
+	// tokenise just this chunk's rows
+	size_t begin = chunkOffsets[chunk];
+	BVHTokenizer tokenizer(std::string_view(file.Data() + begin, chunkOffsets[chunk + 1] - begin));
+	size_t firstFrame = (size_t) slot * chunkFrames;
+	int decoded = 0;
+	for (int frame = 0; frame < chunkFrames; frame++)
+		{ // per frame
+		int parsed = tokenizer.NextFloats(cursor.row.data(), (int) cursor.row.size());
+		if (parsed < 0)
+			break;
+		// a short row leaves its missing channels at zero
+		for (size_t column = parsed; column < cursor.row.size(); column++)
+			cursor.row[column] = 0.0f;
+		skeleton->DecodeFrame(cursor.row.data(), &cursor.pages[(firstFrame + frame) * jointCount], cursor.rootPages[firstFrame + frame]);
+		decoded++;
+		} // per frame
+	// converted once per chunk, so playback itself needs no trigonometry
+	skeleton->ConvertRotations(&cursor.pages[firstFrame * jointCount], &cursor.quaternionPages[firstFrame * jointCount], decoded);
+	cursor.slotChunk[slot] = chunk;
+	chunksDecoded++;
+	} // DecodeChunk()
+
+// number of chunks decoded so far
+long BVHStream::ChunksDecoded() const
+	{ // ChunksDecoded()
+	return chunksDecoded;
+	} // ChunksDecoded()
+
+// bytes of decoded frames held in memory, in every thread's ring
+size_t BVHStream::ResidentBytes() const
+	{ // ResidentBytes()
+	std::lock_guard<std::mutex> lock(cursorLock);
+	size_t bytes = 0;
+	for (const std::unique_ptr<Cursor> &cursor : cursors)
+		bytes += (cursor->pages.size() + cursor->rootPages.size()) * sizeof(Cartesian3)
+			+ cursor->quaternionPages.size() * sizeof(Quaternion);
+	return bytes;
+	} // ResidentBytes()
+
+// bytes of the seek index held in memory
+size_t BVHStream::IndexBytes() const
+	{ // IndexBytes()
+	return chunkOffsets.size() * sizeof(uint64_t);
+	} // IndexBytes()
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	BVHStream.h
+//	------------------------
+//	
+//	Streams the MOTION section of a bvh file: frames are
+//	decoded a chunk at a time into a small ring of pages,
+//	so only a window around the playback cursor is held in
+//	memory however long the capture is. Each thread that
+//	reads the stream has its own cursor (its own ring), so
+//	readers never evict each other's frames.
+//	
+///////////////////////////////////////////////////
+
+#ifndef _BVH_STREAM_H
+#define _BVH_STREAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Cartesian3.h"
+#include "Quaternion.h"
+#include "MappedFile.h"
+
+class BVHData;
+class Skeleton;
+
+class BVHStream
+	{ // class BVHStream
+	public:
+	// chunkFrames frames are decoded at once, and residentChunks chunks are kept
+	BVHStream(int chunkFrames, int residentChunks);
+
+	// map the file, read its hierarchy into the clip, and index the frames
+	bool Open(const char *fileName, BVHData &clip);
+
+	// number of frames in the file
+	int FrameCount() const;
+
+	// rotations of every joint at a frame, decoding its chunk into the calling thread's
+	// ring if it is not resident; safe from several threads at once, but the pointer
+	// is only valid until the same thread next decodes a chunk into the slot it is in
+	// (at the earliest, once it has read a frame residentChunks chunks away)
+	const Cartesian3 *Frame(int frame) const;
+
+	// the same rotations as quaternions (converted as the chunk is decoded), valid for
+	// as long as Frame's
+	const Quaternion *Quaternions(int frame) const;
+
+	// position of the root at a frame, valid for as long as Frame's
+	const Cartesian3 &RootPosition(int frame) const;
+
+	// number of chunks decoded so far, by every thread
+	long ChunksDecoded() const;
+
+	// bytes of decoded frames held in memory (a ring for each thread that has read
+	// the stream) and of the seek index
+	size_t ResidentBytes() const;
+	size_t IndexBytes() const;
+
+	private:
+	// one reading thread's ring of decoded pages: chunkFrames * jointCount rotations
+	// per slot, as Euler angles and as quaternions, and chunkFrames root positions
+	// per slot
+	struct Cursor
+		{ // struct Cursor
+		std::thread::id thread;
+		std::vector<Cartesian3> pages;
+		std::vector<Quaternion> quaternionPages;
+		std::vector<Cartesian3> rootPages;
+
+		// which chunk each slot holds (-1 if none)
+		std::vector<int> slotChunk;
+
+		// scratch row for parsing, reused so decoding does not allocate
+		std::vector<float> row;
+		}; // struct Cursor
+
+	// the calling thread's cursor, made the first time it reads the stream
+	Cursor &ThreadCursor() const;
+
+	// decode a chunk of frames into a slot of a cursor's ring
+	void DecodeChunk(Cursor &cursor, int chunk, int slot) const;
+
+	// index of a frame within a cursor's ring, decoding its chunk if it is not resident
+	size_t ResidentFrame(Cursor &cursor, int frame) const;
+
+	// the file being streamed
+	MappedFile file;
+
+	// the skeleton of the clip being streamed, whose decode table unpacks each row
+	const Skeleton *skeleton;
+
+	// which stream this is, so a thread's last cursor is never mistaken for another's
+	unsigned long long id;
+
+	// sizes
+	int frameCount;
+	int jointCount;
+	int chunkFrames;
+	int residentChunks;
+
+	// byte offset of the first frame of each chunk, with the end of the data last
+	std::vector<uint64_t> chunkOffsets;
+
+	// a cursor for each thread that has read the stream, kept until it is closed
+	// (reading only decodes frames into them, so it is allowed through a const stream)
+	mutable std::mutex cursorLock;
+	mutable std::vector<std::unique_ptr<Cursor>> cursors;
+
+	// number of chunks decoded so far
+	mutable std::atomic<long> chunksDecoded;
+	}; // class BVHStream
+
+#endif
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	BVHTokenizer.cpp
+//	------------------------
+//	
+//	An in-place tokeniser for bvh text: tokens are views
+//	into the source buffer, so nothing is copied or allocated
+//	
+///////////////////////////////////////////////////
+
+#include "BVHTokenizer.h"
+#include <charconv>
+
+// whitespace within a line (newlines are handled separately)
+static inline bool IsBlank(char c)
+	{ // IsBlank()
+	return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+	} // IsBlank()
+
+// constructor takes the text to tokenise, which must outlive the tokeniser
+BVHTokenizer::BVHTokenizer(std::string_view text)
+	: begin(text.data()),
+	cursor(text.data()),
+	end(text.data() + text.size())
+	{ // constructor
+	} // constructor
+
+// read the next non-empty line and split it into tokens
+bool BVHTokenizer::NextLine(std::vector<std::string_view> &tokens)
+	{ // NextLine()
+	// empty out the array of tokens
+	tokens.clear();
+	while (cursor < end)
+		{ // more lines in the text
+		// walk along the line, cutting out tokens as we go
+		while (cursor < end && *cursor != '\n')
+			{ // per character
+			if (IsBlank(*cursor))
+				{ // separator
+				cursor++;
+				continue;
+				} // separator
+			const char *tokenStart = cursor;
+			while (cursor < end && *cursor != '\n' && !IsBlank(*cursor))
+				cursor++;
+			tokens.push_back(std::string_view(tokenStart, cursor - tokenStart));
+			} // per character
+		// step over the newline
+		if (cursor < end)
+			cursor++;
+		// blank lines are skipped
+		if (!tokens.empty())
+			return true;
+		} // more lines in the text
+	return false;
+	} // NextLine()
+
+// read the next non-empty line as a row of floats, storing at most capacity of them
+int BVHTokenizer::NextFloats(float *values, int capacity)
+	{ // NextFloats()
+	while (cursor < end)
+		{ // more lines in the text
+		int count = 0;
+		while (cursor < end && *cursor != '\n')
+			{ // per character
+			if (IsBlank(*cursor))
+				{ // separator
+				cursor++;
+				continue;
+				} // separator
+			// from_chars does not accept an explicit plus sign
+			if (*cursor == '+')
+				cursor++;
+			float value = 0.0f;
+			std::from_chars_result result = std::from_chars(cursor, end, value);
+			if (result.ec == std::errc::invalid_argument)
+				{ // not a number: skip the whole token
+				while (cursor < end && *cursor != '\n' && !IsBlank(*cursor))
+					cursor++;
+				continue;
+				} // not a number
+			// anything beyond the space given is counted but dropped
+			if (count < capacity)
+				values[count] = value;
+			count++;
+			cursor = result.ptr;
+			} // per character
+		// step over the newline
+		if (cursor < end)
+			cursor++;
+		// blank lines are skipped
+		if (count > 0)
+			return count;
+		} // more lines in the text
+	return -1;
+	} // NextFloats()
+
+// true once all of the text has been consumed
+bool BVHTokenizer::AtEnd() const
+	{ // AtEnd()
+	return cursor >= end;
+	} // AtEnd()
+
+// byte offset of the read position from the start of the text
+size_t BVHTokenizer::Offset() const
+	{ // Offset()
+	return cursor - begin;
+	} // Offset()
+
+// convert a token to a float (0 if it does not parse)
+float BVHTokenizer::ToFloat(std::string_view token)
+	{ // ToFloat()
+	float value = 0.0f;
+	if (!token.empty() && token[0] == '+')
+		token.remove_prefix(1);
+	std::from_chars(token.data(), token.data() + token.size(), value);
+	return value;
+	} // ToFloat()
+
+// convert a token to an int (0 if it does not parse)
+int BVHTokenizer::ToInt(std::string_view token)
+	{ // ToInt()
+	int value = 0;
+	if (!token.empty() && token[0] == '+')
+		token.remove_prefix(1);
+	std::from_chars(token.data(), token.data() + token.size(), value);
+	return value;
+	} // ToInt()
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	BVHTokenizer.h
+//	------------------------
+//	
+//	An in-place tokeniser for bvh text: tokens are views
+//	into the source buffer, so nothing is copied or allocated
+//	
+///////////////////////////////////////////////////
+
+#ifndef _BVH_TOKENIZER_H
+#define _BVH_TOKENIZER_H
+
+#include <string_view>
+#include <vector>
+
+class BVHTokenizer
+	{ // class BVHTokenizer
+	public:
+	// constructor takes the text to tokenise, which must outlive the tokeniser
+	BVHTokenizer(std::string_view text);
+
+	// read the next non-empty line and split it into tokens
+	// returns false at the end of the text
+	bool NextLine(std::vector<std::string_view> &tokens);
+
+	// read the next non-empty line as a row of floats, storing at most capacity of them
+	// returns the number of floats on the line, or -1 at the end of the text
+	int NextFloats(float *values, int capacity);
+
+	// true once all of the text has been consumed
+	bool AtEnd() const;
+
+	// byte offset of the read position from the start of the text
+	size_t Offset() const;
+
+	// convert a token to a number (0 if it does not parse)
+	static float ToFloat(std::string_view token);
+	static int ToInt(std::string_view token);
+
+	private:
+	// start of the text, the read position and the end of the text
+	const char *begin;
+	const char *cursor;
+	const char *end;
+	}; // class BVHTokenizer
+
+#endif
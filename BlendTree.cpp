@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	BlendTree.cpp
+//	------------------------
+//
+//	A tree of blend nodes evaluated into one pose every
+//	frame. Clip nodes sample a clip at their own playing
+//	time; lerp nodes blend any number of inputs by weight;
+//	additive nodes add the difference between two inputs
+//	onto a third; select nodes pass one input through;
+//	inertial nodes carry their input over a switch with
+//	an offset that dies away (see Inertializer.h). Each
+//	node works in a scratch frame of its own, sized once,
+//	so no blended clip is ever built and nothing is
+//	allocated once the tree has been evaluated once.
+//
+///////////////////////////////////////////////////
+
+#include "BlendTree.h"
+#include "PoseKernels.h"
+
+#include <algorithm>
+#include <math.h>
+
+// add a node playing a clip from its start
+int BlendTree::AddClip(const ClipHandle &clip, bool loop)
+	{ // AddClip()
+	int node = AddNode(clipNode, std::vector<int>());
+	nodes[node].clip = clip;
+	nodes[node].loop = loop;
+	return node;
+	} // AddClip()
+
+// add a node blending some earlier nodes
+int BlendTree::AddLerp(const std::vector<int> &inputs)
+	{ // AddLerp()
+	return AddNode(lerpNode, inputs);
+	} // AddLerp()
+
+// add a node adding a difference onto a base
+int BlendTree::AddAdditive(int base, int additive, int reference)
+	{ // AddAdditive()
+	int node = AddNode(additiveNode, { base, additive, reference });
+	nodes[node].weights[0] = 1.0f;
+	return node;
+	} // AddAdditive()
+
+// add a node passing one of some earlier nodes through
+int BlendTree::AddSelect(const std::vector<int> &inputs)
+	{ // AddSelect()
+	return AddNode(selectNode, inputs);
+	} // AddSelect()
+
+// add a node smoothing over switches in an earlier node
+int BlendTree::AddInertial(int input, float seconds)
+	{ // AddInertial()
+	int node = AddNode(inertialNode, { input });
+	nodes[node].inertializer.duration = seconds;
+	return node;
+	} // AddInertial()
+
+// start an inertial transition at the next evaluation
+void BlendTree::Transition(int node)
+	{ // Transition()
+	nodes[node].transitionPending = true;
+	} // Transition()
+
+// add a node
+int BlendTree::AddNode(NodeType type, const std::vector<int> &inputs)
+	{ // AddNode()
+	Node node;
+	node.type = type;
+	node.time = 0.0f;
+	node.rate = 1.0f;
+	node.loop = true;
+	node.inputs = inputs;
+	node.weights.assign(inputs.size(), 0.0f);
+	node.selected = 0;
+	node.transitionPending = false;
+	nodes.push_back(node);
+	return (int) nodes.size() - 1;
+	} // AddNode()
+
+// set the weight of one input of a node
+void BlendTree::SetWeight(int node, int input, float weight)
+	{ // SetWeight()
+	nodes[node].weights[input] = weight;
+	} // SetWeight()
+
+// set how fast a clip node plays
+void BlendTree::SetRate(int node, float rate)
+	{ // SetRate()
+	nodes[node].rate = rate;
+	} // SetRate()
+
+// pick the input a select node passes through
+void BlendTree::Select(int node, int input)
+	{ // Select()
+	nodes[node].selected = input;
+	} // Select()
+
+// switch a clip node to a clip
+void BlendTree::Play(int node, const ClipHandle &clip, float time)
+	{ // Play()
+	nodes[node].clip = clip;
+	nodes[node].time = time;
+	} // Play()
+
+// move every clip node on by a number of seconds
+void BlendTree::Advance(float seconds)
+	{ // Advance()
+	for (Node &node : nodes)
+		{ // per node
+		if (node.type == inertialNode)
+			node.inertializer.Advance(seconds);
+		if (node.type != clipNode || !node.clip)
+			continue;
+		node.time += seconds * node.rate;
+		float duration = node.clip->frame_count * node.clip->frame_time;
+		if (node.loop && duration > 0.0f)
+			{ // wrap
+			node.time = fmodf(node.time, duration);
+			if (node.time < 0.0f)
+				node.time += duration;
+			} // wrap
+		} // per node
+	} // Advance()
+
+// fill a pose with a node's output
+void BlendTree::Evaluate(int node, const BVHData &target, Pose &pose)
+	{ // Evaluate()
+	// the scratch frames only grow, so this allocates on the first evaluation at most
+	jointCount = target.skeleton.JointCount();
+	scratch.resize(nodes.size() * jointCount);
+	Cartesian3 rootPosition;
+	const Quaternion *rotations = EvaluateNode(node, rootPosition);
+	// through the incremental evaluation, so joints that the blend leaves still are skipped
+	EvaluatePose(target, rotations, rootPosition, pose);
+	} // Evaluate()
+
+// a node's rotations and root position
+const Quaternion *BlendTree::EvaluateNode(int index, Cartesian3 &rootPosition)
+	{ // EvaluateNode()
+	Node &node = nodes[index];
+	Quaternion *frame = &scratch[(size_t) index * jointCount];
+	switch (node.type)
+		{ // node type
+		case clipNode:
+			SampleRotations(*node.clip, node.time, node.loop, frame, rootPosition);
+			return frame;
+
+		case selectNode:
+			return EvaluateNode(node.inputs[node.selected], rootPosition);
+
+		case lerpNode:
+			{ // lerp
+			float total = 0.0f;
+			int weighted = 0, last = 0;
+			for (size_t input = 0; input < node.inputs.size(); input++)
+				if (node.weights[input] > 0.0f)
+					{ // weighted input
+					total += node.weights[input];
+					weighted++;
+					last = (int) input;
+					} // weighted input
+			// one input with all the weight (or none with any) passes straight through
+			if (weighted <= 1)
+				return EvaluateNode(node.inputs[last], rootPosition);
+			std::fill(frame, frame + jointCount, Quaternion(0.0f, 0.0f, 0.0f, 0.0f));
+			rootPosition = Cartesian3(0.0f, 0.0f, 0.0f);
+			// every input is taken onto the side of the first, so the blend goes the short way
+			const Quaternion *first = nullptr;
+			for (size_t input = 0; input < node.inputs.size(); input++)
+				{ // per input
+				float weight = node.weights[input] / total;
+				if (weight <= 0.0f)
+					continue;
+				Cartesian3 inputRoot;
+				const Quaternion *rotations = EvaluateNode(node.inputs[input], inputRoot);
+				if (first == nullptr)
+					first = rotations;
+				AccumulateRotations(first, rotations, weight, frame, jointCount);
+				rootPosition = rootPosition + inputRoot * weight;
+				} // per input
+			NormalizeRotations(frame, jointCount);
+			return frame;
+			} // lerp
+
+		case additiveNode:
+			{ // additive
+			Cartesian3 baseRoot, additiveRoot, referenceRoot;
+			const Quaternion *base = EvaluateNode(node.inputs[0], baseRoot);
+			const Quaternion *additive = EvaluateNode(node.inputs[1], additiveRoot);
+			const Quaternion *reference = EvaluateNode(node.inputs[2], referenceRoot);
+			float weight = node.weights[0];
+			for (int joint = 0; joint < jointCount; joint++)
+				{ // per joint
+				// the turn from the reference to the additive pose, scaled, then applied to the base
+				Quaternion difference = reference[joint].conjugate() * additive[joint];
+				frame[joint] = base[joint] * Quaternion::Nlerp(Quaternion(), difference, weight);
+				} // per joint
+			rootPosition = baseRoot + (additiveRoot - referenceRoot) * weight;
+			return frame;
+			} // additive
+
+		case inertialNode:
+			{ // inertial
+			const Quaternion *input = EvaluateNode(node.inputs[0], rootPosition);
+			// the offset is taken against the input's first pose after the switch
+			if (node.transitionPending)
+				node.inertializer.Start(input, rootPosition, jointCount);
+			node.transitionPending = false;
+			std::copy(input, input + jointCount, frame);
+			node.inertializer.Apply(frame, rootPosition, jointCount);
+			return frame;
+			} // inertial
+		} // node type
+	return frame;
+	} // EvaluateNode()
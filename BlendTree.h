@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	BlendTree.h
+//	------------------------
+//
+//	A tree of blend nodes evaluated into one pose every
+//	frame. Clip nodes sample a clip at their own playing
+//	time; lerp nodes blend any number of inputs by weight;
+//	additive nodes add the difference between two inputs
+//	onto a third; select nodes pass one input through;
+//	inertial nodes carry their input over a switch with
+//	an offset that dies away (see Inertializer.h). Each
+//	node works in a scratch frame of its own, sized once,
+//	so no blended clip is ever built and nothing is
+//	allocated once the tree has been evaluated once.
+//
+///////////////////////////////////////////////////
+
+#ifndef _BLENDTREE_H
+#define _BLENDTREE_H
+
+#include <vector>
+
+#include "BVHData.h"
+#include "Cartesian3.h"
+#include "Inertializer.h"
+#include "Pose.h"
+#include "Quaternion.h"
+
+class BlendTree
+	{ // class BlendTree
+	public:
+	// what a node does with its inputs
+	enum NodeType
+		{ // enum NodeType
+		clipNode,
+		lerpNode,
+		additiveNode,
+		selectNode,
+		inertialNode
+		}; // enum NodeType
+
+	struct Node
+		{ // struct Node
+		NodeType type;
+
+		// clip nodes: the clip, the seconds into it, how fast it plays and whether it loops
+		ClipHandle clip;
+		float time;
+		float rate;
+		bool loop;
+
+		// the nodes this one combines (always added before it, so the tree has no cycles)
+		// lerp: any number, blended in proportion to their weights (inputs of weight 0 are
+		// not evaluated at all); additive: base, additive and reference, with weights[0]
+		// the share of (additive - reference) added onto base; select: any number, of
+		// which only input selected is evaluated; inertial: one, to which the offset from
+		// the pose shown before a transition is added
+		std::vector<int> inputs;
+		std::vector<float> weights;
+		int selected;
+
+		// inertial nodes: the offset, and whether a transition starts at the next evaluation
+		Inertializer inertializer;
+		bool transitionPending;
+		}; // struct Node
+
+	// the nodes, in the order they were added
+	std::vector<Node> nodes;
+
+	// add a node playing a clip from its start; returns its index
+	int AddClip(const ClipHandle &clip, bool loop = true);
+
+	// add a node blending some earlier nodes, all of weight 0 to start with
+	int AddLerp(const std::vector<int> &inputs);
+
+	// add a node adding the difference between an additive input and a reference input
+	// onto a base input, fully to start with
+	int AddAdditive(int base, int additive, int reference);
+
+	// add a node passing one of some earlier nodes through, the first to start with
+	int AddSelect(const std::vector<int> &inputs);
+
+	// add a node smoothing over switches in an earlier node, each offset dying away
+	// within the given seconds
+	int AddInertial(int input, float seconds);
+
+	// start an inertial transition from what a node showed last to what its input
+	// gives next (call after switching anything under it: a clip, a weight or a selection)
+	void Transition(int node);
+
+	// set the weight of one input of a node
+	void SetWeight(int node, int input, float weight);
+
+	// set how fast a clip node plays
+	void SetRate(int node, float rate);
+
+	// pick the input a select node passes through
+	void Select(int node, int input);
+
+	// switch a clip node to a clip, from some seconds in
+	void Play(int node, const ClipHandle &clip, float time);
+
+	// move every clip node on by a number of seconds (scaled by its rate), and every
+	// inertial transition
+	void Advance(float seconds);
+
+	// fill a pose with a node's output on the skeleton of a clip (which must share the
+	// layout of every clip in the tree)
+	void Evaluate(int node, const BVHData &target, Pose &pose);
+
+	private:
+	// a node's rotations and root position, in its scratch frame or that of an input
+	const Quaternion *EvaluateNode(int node, Cartesian3 &rootPosition);
+
+	// add a node, making room for its scratch frame
+	int AddNode(NodeType type, const std::vector<int> &inputs);
+
+	// joints in each scratch frame, and the frames themselves, one per node
+	int jointCount = 0;
+	std::vector<Quaternion> scratch;
+	}; // class BlendTree
+
+#endif
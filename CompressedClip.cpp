@@ -0,0 +1,390 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	CompressedClip.cpp
+//	------------------------
+//
+//	An error-bounded compressed copy of a clip's rotation
+//	and root position tracks. Each track (one axis of one
+//	joint) is either a single constant, kept as one float
+//	and a bit of a mask, or 16-bit keys quantized over the
+//	track's own range, with keys that linear interpolation
+//	can rebuild dropped as long as no joint moves by more
+//	than a given distance. A clip that would be no smaller
+//	that way (e.g. one of a single frame) is kept raw.
+//
+///////////////////////////////////////////////////
+
+#include "CompressedClip.h"
+#include "BVHData.h"
+#include "Pose.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// the largest quantized value
+static const float quantizationLevels = 65535.0f;
+
+// bones shorter than this still get a finite rotation tolerance (e.g. leaf joints,
+// whose rotation moves nothing the renderer draws)
+static const float minimumReach = 1.0f;
+
+// the id the last compression was given (0 is never given, so an empty cache entry
+// matches nothing)
+static std::atomic<unsigned long long> lastId(0);
+
+// one frame in the calling thread's cache
+struct CompressedClip::DecodedFrame
+	{ // struct DecodedFrame
+	unsigned long long clip = 0;
+	int frame = -1;
+	bool converted = false;
+	std::vector<Cartesian3> rotations;
+	std::vector<Quaternion> quaternions;
+	Cartesian3 rootPosition;
+	}; // struct DecodedFrame
+
+// frames each thread keeps decoded: two, so sampling between a frame and the next
+// (and playing on from one pair to the next) decodes and converts each frame once
+static const int decodedFrames = 2;
+
+// constructor will initialise to an empty clip
+CompressedClip::CompressedClip()
+	: skeleton(nullptr),
+	id(++lastId),
+	frameCount(0),
+	jointCount(0),
+	trackCount(3)
+	{ // constructor
+	} // constructor
+
+// compress a loaded clip
+void CompressedClip::Compress(const BVHData &clip, float maxError)
+	{ // Compress()
+	const Skeleton &skeleton = clip.skeleton;
+	this->skeleton = &skeleton;
+	frameCount = clip.frame_count;
+	jointCount = skeleton.JointCount();
+	trackCount = 3 * jointCount + 3;
+	id = ++lastId;
+	std::vector<float> tolerances(3 * jointCount + 3, 0.0f);
+	// key frames are stored in 16 bits, so longer clips are only quantized
+	if (maxError <= 0.0f || frameCount > 65536)
+		{ // keep every key
+		Build(clip, tolerances);
+		return;
+		} // keep every key
+
+	// a rotation error of theta radians moves a joint's descendants by at most
+	// theta times the longest chain of bones below it
+	std::vector<float> reach(jointCount, 0.0f);
+	std::vector<int> depth(jointCount, 0);
+	int maxDepth = 0;
+	for (int joint = 0; joint < jointCount; joint++)
+		{ // parents before children
+		depth[joint] = skeleton.parent[joint] < 0 ? 1 : depth[skeleton.parent[joint]] + 1;
+		maxDepth = std::max(maxDepth, depth[joint]);
+		} // parents before children
+	for (int joint = jointCount - 1; joint > 0; joint--)
+		{ // children before parents
+		int parent = skeleton.parent[joint];
+		if (parent >= 0)
+			reach[parent] = std::max(reach[parent], reach[joint] + skeleton.offset[joint].length());
+		} // children before parents
+
+	// start with every track allowed the whole budget (split over its three axes),
+	// and halve that until the error measured over the clip fits; the last try splits
+	// the budget along the deepest chain as well, so the errors cannot add up past it
+	float smallestShare = 1.0f / (maxDepth + 1);
+	for (float share = 1.0f; ; share *= 0.5f)
+		{ // per try
+		share = std::max(share, smallestShare);
+		float axisBudget = maxError * share / 3.0f;
+		for (int joint = 0; joint < jointCount; joint++)
+			for (int axis = 0; axis < 3; axis++)
+				tolerances[3 * joint + axis] = axisBudget / std::max(reach[joint], minimumReach) * (float) (180.0 / M_PI);
+		for (int axis = 0; axis < 3; axis++)
+			tolerances[3 * jointCount + axis] = axisBudget;
+		Build(clip, tolerances);
+		if (share == smallestShare || MeasureError(clip) <= maxError)
+			break;
+		} // per try
+	} // Compress()
+
+// compress every track of a clip to its own tolerance
+void CompressedClip::Build(const BVHData &clip, const std::vector<float> &tolerances)
+	{ // Build()
+	constantMask.assign((trackCount + 31) / 32, 0);
+	constants.clear();
+	tracks.clear();
+	keyData.clear();
+	rawFrames.clear();
+
+	// gather each track into a scratch column
+	std::vector<float> values(frameCount);
+	std::vector<float> decoded(frameCount);
+	std::vector<uint16_t> quantized(frameCount);
+	std::vector<int> keys;
+	for (int track = 0; track < trackCount; track++)
+		{ // per track
+		int joint = track / 3, axis = track % 3;
+		bool rootPosition = joint == jointCount;
+		for (int frame = 0; frame < frameCount; frame++)
+			values[frame] = rootPosition ? clip.RootPosition(frame)[axis] : clip.JointRotation(frame, joint)[axis];
+		// in the track's own units (degrees for a rotation)
+		float tolerance = tolerances[track];
+
+		float minimum = frameCount > 0 ? *std::min_element(values.begin(), values.end()) : 0.0f;
+		float maximum = frameCount > 0 ? *std::max_element(values.begin(), values.end()) : 0.0f;
+		// a track that never leaves its tolerance is stored as a single value
+		if (maximum - minimum <= 2.0f * tolerance)
+			{ // constant
+			constantMask[track / 32] |= 1u << (track % 32);
+			constants.push_back(0.5f * (minimum + maximum));
+			continue;
+			} // constant
+
+		// quantize every frame over the track's range
+		CompressedTrack record;
+		record.firstKey = (uint32_t) keyData.size();
+		record.minimum = minimum;
+		record.step = (maximum - minimum) / quantizationLevels;
+		for (int frame = 0; frame < frameCount; frame++)
+			{ // per frame
+			quantized[frame] = (uint16_t) std::lround((values[frame] - minimum) / record.step);
+			decoded[frame] = minimum + record.step * quantized[frame];
+			} // per frame
+
+		// greedily stretch each segment between keys as far as interpolation stays in tolerance
+		keys.assign(1, 0);
+		int start = 0;
+		while (tolerance > 0.0f && start < frameCount - 1)
+			{ // per segment
+			int end = start + 1;
+			while (end + 1 < frameCount)
+				{ // try a longer segment
+				int candidate = end + 1;
+				bool fits = true;
+				for (int frame = start + 1; frame < candidate && fits; frame++)
+					{ // per skipped frame
+					float t = (float) (frame - start) / (candidate - start);
+					float value = decoded[start] + t * (decoded[candidate] - decoded[start]);
+					fits = std::fabs(value - values[frame]) <= tolerance;
+					} // per skipped frame
+				if (!fits)
+					break;
+				end = candidate;
+				} // try a longer segment
+			keys.push_back(end);
+			start = end;
+			} // per segment
+
+		// a sparse track stores a frame and a value per key, so past half the frames
+		// storing every value is no bigger
+		if (tolerance <= 0.0f || 2 * keys.size() >= (size_t) frameCount)
+			{ // dense
+			record.keyCount = (uint32_t) frameCount;
+			keyData.insert(keyData.end(), quantized.begin(), quantized.end());
+			} // dense
+		else
+			{ // sparse
+			record.keyCount = (uint32_t) keys.size();
+			for (int key : keys)
+				keyData.push_back((uint16_t) key);
+			for (int key : keys)
+				keyData.push_back(quantized[key]);
+			} // sparse
+		tracks.push_back(record);
+		} // per track
+
+	// a clip with little to strip (one of a single frame has no keys to drop, and
+	// every track is constant) is kept as it is, rather than growing
+	if (CompressedBytes() >= (size_t) frameCount * trackCount * sizeof(float))
+		{ // raw
+		rawFrames.resize((size_t) frameCount * trackCount);
+		for (int frame = 0; frame < frameCount; frame++)
+			{ // per frame
+			float *row = &rawFrames[(size_t) frame * trackCount];
+			for (int joint = 0; joint < jointCount; joint++)
+				for (int axis = 0; axis < 3; axis++)
+					row[3 * joint + axis] = clip.JointRotation(frame, joint)[axis];
+			for (int axis = 0; axis < 3; axis++)
+				row[3 * jointCount + axis] = clip.RootPosition(frame)[axis];
+			} // per frame
+		constantMask.clear();
+		constants.clear();
+		tracks.clear();
+		keyData.clear();
+		} // raw
+	} // Build()
+
+// number of frames
+int CompressedClip::FrameCount() const
+	{ // FrameCount()
+	return frameCount;
+	} // FrameCount()
+
+// whether a track is stored as a single value
+bool CompressedClip::IsConstant(int track) const
+	{ // IsConstant()
+	return (constantMask[track / 32] >> (track % 32)) & 1u;
+	} // IsConstant()
+
+// value of one track that is not constant at a frame
+float CompressedClip::SampleTrack(const CompressedTrack &track, int frame) const
+	{ // SampleTrack()
+	const uint16_t *keys = &keyData[track.firstKey];
+	// a key every frame
+	if ((int) track.keyCount == frameCount)
+		return track.minimum + track.step * keys[frame];
+	// find the keys either side (the first and last frames are always keys)
+	const uint16_t *frames = keys;
+	const uint16_t *values = keys + track.keyCount;
+	int next = (int) (std::upper_bound(frames, frames + track.keyCount, (uint16_t) frame) - frames);
+	if (next >= (int) track.keyCount)
+		return track.minimum + track.step * values[track.keyCount - 1];
+	int previous = next - 1;
+	float t = (float) (frame - frames[previous]) / (frames[next] - frames[previous]);
+	float quantized = values[previous] + t * ((float) values[next] - values[previous]);
+	return track.minimum + track.step * quantized;
+	} // SampleTrack()
+
+// decode a whole frame
+void CompressedClip::DecodeFrame(int frame, Cartesian3 *rotations, Cartesian3 &rootPosition) const
+	{ // DecodeFrame()
+	// an empty clip has nothing to decode
+	if (frameCount == 0)
+		{ // empty
+		std::fill(rotations, rotations + jointCount, Cartesian3());
+		rootPosition = Cartesian3();
+		return;
+		} // empty
+	// clamp to the frames that exist
+	if (frame >= frameCount)
+		frame = frameCount - 1;
+	if (frame < 0)
+		frame = 0;
+	if (!rawFrames.empty())
+		{ // raw
+		const float *row = &rawFrames[(size_t) frame * trackCount];
+		for (int joint = 0; joint < jointCount; joint++, row += 3)
+			rotations[joint] = Cartesian3(row[0], row[1], row[2]);
+		rootPosition = Cartesian3(row[0], row[1], row[2]);
+		return;
+		} // raw
+	// the constants and the other records are each in track order, so both are read
+	// straight through
+	const float *constant = constants.data();
+	const CompressedTrack *record = tracks.data();
+	int track = 0;
+	for (int joint = 0; joint <= jointCount; joint++)
+		{ // per joint, then the root position
+		float axes[3];
+		for (int axis = 0; axis < 3; axis++, track++)
+			axes[axis] = IsConstant(track) ? *constant++ : SampleTrack(*record++, frame);
+		if (joint < jointCount)
+			rotations[joint] = Cartesian3(axes[0], axes[1], axes[2]);
+		else
+			rootPosition = Cartesian3(axes[0], axes[1], axes[2]);
+		} // per joint, then the root position
+	} // DecodeFrame()
+
+// the calling thread's cached copy of a frame
+CompressedClip::DecodedFrame &CompressedClip::Decoded(int frame, bool quaternions) const
+	{ // Decoded()
+	thread_local DecodedFrame cache[decodedFrames];
+	thread_local int oldest = 0;
+	DecodedFrame *decoded = nullptr;
+	for (DecodedFrame &entry : cache)
+		if (entry.clip == id && entry.frame == frame)
+			decoded = &entry;
+	if (decoded == nullptr)
+		{ // decode
+		// into the entry decoded longest ago, leaving the other one valid
+		decoded = &cache[oldest];
+		oldest = (oldest + 1) % decodedFrames;
+		decoded->rotations.resize(jointCount);
+		DecodeFrame(frame, decoded->rotations.data(), decoded->rootPosition);
+		decoded->clip = id;
+		decoded->frame = frame;
+		decoded->converted = false;
+		} // decode
+	// the tracks hold Euler angles, so the trig to convert them is only done once a
+	// caller wants quaternions, and then once per frame decoded
+	if (quaternions && !decoded->converted)
+		{ // convert
+		decoded->quaternions.resize(jointCount);
+		skeleton->ConvertRotations(decoded->rotations.data(), decoded->quaternions.data(), 1);
+		decoded->converted = true;
+		} // convert
+	return *decoded;
+	} // Decoded()
+
+// rotations of every joint at a frame, through the calling thread's cache
+const Cartesian3 *CompressedClip::Frame(int frame) const
+	{ // Frame()
+	return Decoded(frame, false).rotations.data();
+	} // Frame()
+
+// the same rotations as quaternions, through the calling thread's cache
+const Quaternion *CompressedClip::Quaternions(int frame) const
+	{ // Quaternions()
+	return Decoded(frame, true).quaternions.data();
+	} // Quaternions()
+
+// root position at a frame, through the calling thread's cache
+const Cartesian3 &CompressedClip::RootPosition(int frame) const
+	{ // RootPosition()
+	return Decoded(frame, false).rootPosition;
+	} // RootPosition()
+
+// number of tracks stored as a single value
+int CompressedClip::ConstantTracks() const
+	{ // ConstantTracks()
+	return (int) constants.size();
+	} // ConstantTracks()
+
+// number of tracks
+int CompressedClip::TrackCount() const
+	{ // TrackCount()
+	return trackCount;
+	} // TrackCount()
+
+// number of keys kept over every track
+size_t CompressedClip::KeyCount() const
+	{ // KeyCount()
+	if (!rawFrames.empty())
+		return rawFrames.size();
+	size_t keys = 0;
+	for (const CompressedTrack &track : tracks)
+		keys += track.keyCount;
+	return keys;
+	} // KeyCount()
+
+// bytes of compressed data held
+size_t CompressedClip::CompressedBytes() const
+	{ // CompressedBytes()
+	return (constantMask.size() + constants.size()) * sizeof(uint32_t) + tracks.size() * sizeof(CompressedTrack)
+		+ keyData.size() * sizeof(uint16_t) + rawFrames.size() * sizeof(float);
+	} // CompressedBytes()
+
+// worst distance any joint moves between the original clip and this copy
+float CompressedClip::MeasureError(const BVHData &original) const
+	{ // MeasureError()
+	Pose originalPose, pose;
+	std::vector<Cartesian3> rotations(jointCount);
+	std::vector<Quaternion> quaternions(jointCount);
+	Cartesian3 rootPosition;
+	float worst = 0.0f;
+	for (int frame = 0; frame < frameCount; frame++)
+		{ // per frame
+		EvaluateFrame(original, frame, originalPose);
+		DecodeFrame(frame, rotations.data(), rootPosition);
+		skeleton->ConvertRotations(rotations.data(), quaternions.data(), 1);
+		EvaluatePose(original, quaternions.data(), rootPosition, pose);
+		for (int joint = 0; joint < jointCount; joint++)
+			worst = std::max(worst, (pose.ClipPosition(joint) - originalPose.ClipPosition(joint)).length());
+		} // per frame
+	return worst;
+	} // MeasureError()
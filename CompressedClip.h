@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	CompressedClip.h
+//	------------------------
+//
+//	An error-bounded compressed copy of a clip's rotation
+//	and root position tracks. Each track (one axis of one
+//	joint) is either a single constant, kept as one float
+//	and a bit of a mask, or 16-bit keys quantized over the
+//	track's own range, with keys that linear interpolation
+//	can rebuild dropped as long as no joint moves by more
+//	than a given distance. A clip that would be no smaller
+//	that way (e.g. one of a single frame) is kept raw.
+//
+///////////////////////////////////////////////////
+
+#ifndef _COMPRESSEDCLIP_H
+#define _COMPRESSEDCLIP_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Cartesian3.h"
+#include "Quaternion.h"
+
+class BVHData;
+class Skeleton;
+
+// one axis of one joint's rotation, or of the root position, that is not constant
+struct CompressedTrack
+	{ // struct CompressedTrack
+	// value of key 0 and the size of one quantization step
+	float minimum;
+	float step;
+	// index of the track's keys in keyData: a sparse track lists the frame of each
+	// key and then their values, a dense track (a key every frame) only the values
+	uint32_t firstKey;
+	// number of keys: the clip's frame count for a dense track
+	uint32_t keyCount;
+	}; // struct CompressedTrack
+
+class CompressedClip
+	{ // class CompressedClip
+	public:
+	// constructor will initialise to an empty clip
+	CompressedClip();
+
+	// compress a loaded clip; keys are dropped while no joint moves by more than
+	// maxError (in skeleton units) on any frame, or never if maxError is zero or less
+	// constant tracks are stripped and every other track is quantized either way,
+	// unless that leaves the clip no smaller, when its values are kept as they are
+	void Compress(const BVHData &clip, float maxError);
+
+	// number of frames
+	int FrameCount() const;
+
+	// decode a whole frame; safe to call from several threads at once
+	void DecodeFrame(int frame, Cartesian3 *rotations, Cartesian3 &rootPosition) const;
+
+	// rotations of every joint at a frame, decoded into a cache of the last two frames
+	// the calling thread decoded (from any compressed clip), so two frames can be read
+	// side by side; safe from several threads at once, but what it returns is only
+	// valid until the same thread has decoded two other frames
+	const Cartesian3 *Frame(int frame) const;
+
+	// the same rotations as quaternions, from the same cache; a frame's rotations are
+	// converted the first time its quaternions are asked for
+	const Quaternion *Quaternions(int frame) const;
+
+	// root position at a frame, from the same cache
+	const Cartesian3 &RootPosition(int frame) const;
+
+	// statistics for reporting
+	int ConstantTracks() const;
+	int TrackCount() const;
+	size_t KeyCount() const;
+	size_t CompressedBytes() const;
+
+	// worst distance any joint moves between the original clip and this copy
+	// over every frame (forward kinematics without the renderer's scale)
+	float MeasureError(const BVHData &original) const;
+
+	private:
+	// one frame in the calling thread's cache
+	struct DecodedFrame;
+
+	// the calling thread's cached copy of a frame, decoding it (and converting it to
+	// quaternions if asked) if it is not there
+	DecodedFrame &Decoded(int frame, bool quaternions) const;
+
+	// compress every track of a clip to its own tolerance (0 keeps every key)
+	void Build(const BVHData &clip, const std::vector<float> &tolerances);
+
+	// whether a track is stored as a single value
+	bool IsConstant(int track) const;
+
+	// value of one track that is not constant at a frame
+	float SampleTrack(const CompressedTrack &track, int frame) const;
+
+	// the skeleton of the clip, whose channel order converts the rotations
+	const Skeleton *skeleton;
+
+	// which compression this is, so a thread's cache never mistakes another clip
+	// (or this one compressed again) for it
+	unsigned long long id;
+
+	// sizes
+	int frameCount;
+	int jointCount;
+
+	// 3 tracks per joint (x, y, z rotation) followed by 3 for the root position
+	int trackCount;
+
+	// a bit per track, set for one stored as a single value, and those values in
+	// track order (so a constant track costs a float, not a whole record)
+	std::vector<uint32_t> constantMask;
+	std::vector<float> constants;
+
+	// the record of every other track, in track order
+	std::vector<CompressedTrack> tracks;
+
+	// the keys of every track, back to back
+	std::vector<uint16_t> keyData;
+
+	// every track's value on every frame, frame-major, kept in place of all the above
+	// when they would take no less room
+	std::vector<float> rawFrames;
+	}; // class CompressedClip
+
+#endif
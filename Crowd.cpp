@@ -0,0 +1,278 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Crowd.cpp
+//	------------------------
+//
+//	Any number of characters, each with its own clip,
+//	playback time, blend and place in the world, held as
+//	parallel arrays (one entry per character) and updated
+//	on a pool of worker threads every frame. Characters
+//	only read shared clips and write their own entries, so
+//	the result is the same on any number of threads.
+//	(Streamed and compressed clips decode into a cache
+//	for each thread, so they may be shared too.)
+//
+///////////////////////////////////////////////////
+
+#include "Crowd.h"
+#include "GaitTrack.h"
+
+#include <algorithm>
+#include <math.h>
+
+// characters claimed by a worker at a time: enough to keep the claims cheap,
+// few enough that the workers finish together
+static const int charactersPerClaim = 32;
+
+// mix a character's index and a count into a well-spread number
+static unsigned Hash(unsigned character, unsigned count)
+	{ // Hash()
+	unsigned value = character * 0x9E3779B9u ^ (count + 0x7F4A7C15u);
+	value ^= value >> 16;
+	value *= 0x85EBCA6Bu;
+	value ^= value >> 13;
+	value *= 0xC2B2AE35u;
+	value ^= value >> 16;
+	return value;
+	} // Hash()
+
+// workers to update on
+Crowd::Crowd(unsigned threadCount)
+	: scale(1.0f),
+	wanderInterval(0.0f),
+	wanderBlend(0.0f),
+	generation(0),
+	busyWorkers(0),
+	stopping(false),
+	nextCharacter(0),
+	stepSeconds(0.0f)
+	{ // constructor
+	SetThreadCount(threadCount);
+	} // constructor
+
+// destructor
+Crowd::~Crowd()
+	{ // destructor
+	StopWorkers();
+	} // destructor
+
+// change the number of worker threads
+void Crowd::SetThreadCount(unsigned threadCount)
+	{ // SetThreadCount()
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	StopWorkers();
+	// the calling thread is a worker too, so the pool holds one fewer
+	stopping = false;
+	for (unsigned worker = 1; worker < threadCount; worker++)
+		workers.emplace_back(&Crowd::WorkerLoop, this, generation);
+	} // SetThreadCount()
+
+// number of worker threads, counting the calling thread
+unsigned Crowd::ThreadCount() const
+	{ // ThreadCount()
+	return (unsigned) workers.size() + 1;
+	} // ThreadCount()
+
+// stop and join the pool threads
+void Crowd::StopWorkers()
+	{ // StopWorkers()
+	{ // lock
+	std::lock_guard<std::mutex> lock(poolMutex);
+	stopping = true;
+	} // lock
+	workReady.notify_all();
+	for (std::thread &worker : workers)
+		worker.join();
+	workers.clear();
+	} // StopWorkers()
+
+// number of characters
+int Crowd::Size() const
+	{ // Size()
+	return (int) clip.size();
+	} // Size()
+
+// remove every character
+void Crowd::Clear()
+	{ // Clear()
+	clip.clear();
+	time.clear();
+	blendClip.clear();
+	blendTime.clear();
+	blendRemaining.clear();
+	blendDuration.clear();
+	location.clear();
+	heading.clear();
+	wanderCountdown.clear();
+	wanderCount.clear();
+	world.clear();
+	pose.clear();
+	} // Clear()
+
+// add a character playing a clip from a given time
+int Crowd::Add(const ClipHandle &startClip, const Cartesian3 &startLocation, float startHeading, float startTime)
+	{ // Add()
+	int character = Size();
+	clip.push_back(startClip);
+	time.push_back(startTime);
+	blendClip.push_back(ClipHandle());
+	blendTime.push_back(0.0f);
+	blendRemaining.push_back(0.0f);
+	blendDuration.push_back(0.0f);
+	location.push_back(startLocation);
+	heading.push_back(startHeading);
+	// spread the first choices out, so the crowd does not all turn at once
+	wanderCountdown.push_back(wanderInterval * (Hash(character, ~0u) % 1024) / 1024.0f);
+	wanderCount.push_back(0);
+	world.push_back(Matrix4::Translate(startLocation) * Matrix4::RotateZ(startHeading));
+	pose.push_back(Pose());
+	return character;
+	} // Add()
+
+// switch a character to a clip, blending from what it plays now
+void Crowd::Play(int character, const ClipHandle &nextClip, float blendSeconds)
+	{ // Play()
+	if (blendSeconds > 0.0f)
+		{ // blend
+		// the clip being left keeps playing underneath until the blend ends
+		blendClip[character] = clip[character];
+		blendTime[character] = time[character];
+		blendRemaining[character] = blendDuration[character] = blendSeconds;
+		} // blend
+	else
+		blendClip[character].reset();
+	// a stepping character carries on at the same point in its stride
+	const GaitTrack *from = clip[character] ? clip[character]->gait.get() : nullptr;
+	const GaitTrack *to = nextClip->gait.get();
+	bool synced = from != nullptr && to != nullptr && from->HasPhase() && to->HasPhase();
+	time[character] = synced ? to->TimeAtPhase(from->Phase(time[character])) : 0.0f;
+	clip[character] = nextClip;
+	} // Play()
+
+// let every character pick a new clip from these every interval seconds
+void Crowd::Wander(const std::vector<ClipHandle> &clips, float interval, float blendSeconds)
+	{ // Wander()
+	wanderClips = clips;
+	wanderInterval = interval;
+	wanderBlend = blendSeconds;
+	for (int character = 0; character < Size(); character++)
+		wanderCountdown[character] = interval * (Hash(character, ~0u) % 1024) / 1024.0f;
+	} // Wander()
+
+// advance every character by a number of seconds, on every worker
+void Crowd::Update(float seconds)
+	{ // Update()
+	stepSeconds = seconds;
+	nextCharacter.store(0);
+	{ // lock
+	std::lock_guard<std::mutex> lock(poolMutex);
+	busyWorkers = (unsigned) workers.size();
+	generation++;
+	} // lock
+	workReady.notify_all();
+	// the calling thread works too, then waits for the rest
+	Work();
+	std::unique_lock<std::mutex> lock(poolMutex);
+	workDone.wait(lock, [this]() { return busyWorkers == 0; });
+	} // Update()
+
+// the work evaluating every character's pose has done and skipped
+PoseCounters Crowd::Counters() const
+	{ // Counters()
+	PoseCounters total;
+	for (const Pose &characterPose : pose)
+		total += characterPose.counters;
+	return total;
+	} // Counters()
+
+// the loop a pool thread runs
+void Crowd::WorkerLoop(unsigned long seen)
+	{ // WorkerLoop()
+	for (;;)
+		{ // per update
+		{ // lock
+		std::unique_lock<std::mutex> lock(poolMutex);
+		workReady.wait(lock, [this, seen]() { return stopping || generation != seen; });
+		if (stopping)
+			return;
+		seen = generation;
+		} // lock
+		Work();
+		{ // lock
+		std::lock_guard<std::mutex> lock(poolMutex);
+		busyWorkers--;
+		} // lock
+		workDone.notify_one();
+		} // per update
+	} // WorkerLoop()
+
+// update characters until none are left unclaimed
+void Crowd::Work()
+	{ // Work()
+	int size = Size();
+	for (int first = nextCharacter.fetch_add(charactersPerClaim); first < size; first = nextCharacter.fetch_add(charactersPerClaim))
+		for (int character = first; character < std::min(size, first + charactersPerClaim); character++)
+			UpdateCharacter(character, stepSeconds);
+	} // Work()
+
+// advance one character
+void Crowd::UpdateCharacter(int character, float seconds)
+	{ // UpdateCharacter()
+	// pick the next clip to wander into
+	if (!wanderClips.empty())
+		{ // wandering
+		wanderCountdown[character] -= seconds;
+		if (wanderCountdown[character] <= 0.0f)
+			{ // choose
+			const ClipHandle &choice = wanderClips[Hash(character, wanderCount[character]++) % wanderClips.size()];
+			wanderCountdown[character] += wanderInterval;
+			if (choice != clip[character])
+				Play(character, choice, wanderBlend);
+			} // choose
+		} // wandering
+
+	// move on through the clip, taking a root motion step for every frame passed
+	const BVHData &current = *clip[character];
+	Matrix4 facing = Matrix4::RotateZ(heading[character]);
+	int frame = FrameAt(current, time[character]);
+	time[character] += seconds;
+	int lastFrame = FrameAt(current, time[character]);
+	for (; frame < lastFrame; frame++)
+		{ // per frame passed
+		const RootMotionDelta &step = current.RootMotion(frame % current.frame_count);
+		location[character] = location[character] + facing * (clipToScene * step.translation * scale);
+		if (step.yaw != 0.0f)
+			{ // turn
+			heading[character] += step.yaw;
+			facing = Matrix4::RotateZ(heading[character]);
+			} // turn
+		} // per frame passed
+	// and loop
+	float duration = current.frame_count * current.frame_time;
+	if (duration > 0.0f)
+		time[character] = fmodf(time[character], duration);
+	world[character] = Matrix4::Translate(location[character]) * facing;
+
+	// the pose: the clip's own, or blended with the one being left
+	if (!blendClip[character])
+		{ // one clip
+		Sample(current, time[character], pose[character], true);
+		return;
+		} // one clip
+	const BVHData &previous = *blendClip[character];
+	blendTime[character] += seconds;
+	float previousDuration = previous.frame_count * previous.frame_time;
+	if (previousDuration > 0.0f)
+		blendTime[character] = fmodf(blendTime[character], previousDuration);
+	blendRemaining[character] -= seconds;
+	float weight = 1.0f - std::max(blendRemaining[character], 0.0f) / blendDuration[character];
+	int toFrame = std::min(FrameAt(current, time[character]), current.frame_count - 1);
+	int fromFrame = std::min(FrameAt(previous, blendTime[character]), previous.frame_count - 1);
+	Cartesian3 rootPosition = previous.RootPosition(fromFrame) * (1.0f - weight) + current.RootPosition(toFrame) * weight;
+	EvaluateBlend(current, previous.FrameQuaternions(fromFrame), current.FrameQuaternions(toFrame), weight, rootPosition, pose[character]);
+	// the blend is over once the clip being left no longer shows
+	if (blendRemaining[character] <= 0.0f)
+		blendClip[character].reset();
+	} // UpdateCharacter()
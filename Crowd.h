@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Crowd.h
+//	------------------------
+//
+//	Any number of characters, each with its own clip,
+//	playback time, blend and place in the world, held as
+//	parallel arrays (one entry per character) and updated
+//	on a pool of worker threads every frame. Characters
+//	only read shared clips and write their own entries, so
+//	the result is the same on any number of threads.
+//	(Streamed and compressed clips decode into a cache
+//	for each thread, so they may be shared too.)
+//
+///////////////////////////////////////////////////
+
+#ifndef _CROWD_H
+#define _CROWD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BVHData.h"
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "Pose.h"
+#include "Quaternion.h"
+
+class Crowd
+	{ // class Crowd
+	public:
+	// the clip each character is playing, and how far into it it is, in seconds
+	std::vector<ClipHandle> clip;
+	std::vector<float> time;
+
+	// the clip each character is blending out of (empty when not blending), how far
+	// into that clip it is, and the seconds the blend has left and lasts for in all
+	std::vector<ClipHandle> blendClip;
+	std::vector<float> blendTime;
+	std::vector<float> blendRemaining;
+	std::vector<float> blendDuration;
+
+	// where each character stands on the ground, and the way it faces (degrees about z)
+	std::vector<Cartesian3> location;
+	std::vector<float> heading;
+
+	// the seconds until each character next picks a clip to wander into, and how many
+	// times it has picked one (which seeds the next choice)
+	std::vector<float> wanderCountdown;
+	std::vector<unsigned> wanderCount;
+
+	// results of the last update: each character's world transform (its location and
+	// heading) and its pose in the clip's units
+	std::vector<Matrix4> world;
+	std::vector<Pose> pose;
+
+	// scene units per clip unit, for the root motion
+	float scale;
+
+	// workers to update on (0 means one per core; the calling thread is one of them)
+	explicit Crowd(unsigned threadCount = 0);
+	~Crowd();
+
+	// the pool owns threads, so a crowd cannot be copied
+	Crowd(const Crowd &) = delete;
+	Crowd &operator=(const Crowd &) = delete;
+
+	// change the number of worker threads
+	void SetThreadCount(unsigned threadCount);
+	unsigned ThreadCount() const;
+
+	// number of characters
+	int Size() const;
+
+	// remove every character
+	void Clear();
+
+	// add a character playing a clip from a given time; returns its index
+	int Add(const ClipHandle &startClip, const Cartesian3 &startLocation, float startHeading, float startTime);
+
+	// switch a character to a clip, blending over the given seconds from what it plays now
+	// (entering it at the same phase of the stride, if both clips step; otherwise at its start)
+	void Play(int character, const ClipHandle &nextClip, float blendSeconds);
+
+	// let every character pick a new clip from these every interval seconds, blending
+	// into it (the choice is a hash of the character and its count of choices, so it
+	// does not depend on the order characters are updated in); empty to stop
+	void Wander(const std::vector<ClipHandle> &clips, float interval, float blendSeconds);
+
+	// advance every character by a number of seconds, on every worker
+	void Update(float seconds);
+
+	// the work evaluating every character's pose has done and skipped (see Pose.h)
+	PoseCounters Counters() const;
+
+	private:
+	// advance one character
+	void UpdateCharacter(int character, float seconds);
+
+	// update characters until none are left unclaimed
+	void Work();
+
+	// the loop a pool thread runs, starting from the generation it was made in
+	void WorkerLoop(unsigned long seen);
+
+	// stop and join the pool threads
+	void StopWorkers();
+
+	// the clips to wander between, and how often and how smoothly
+	std::vector<ClipHandle> wanderClips;
+	float wanderInterval;
+	float wanderBlend;
+
+	// the pool: threads wait for the generation to change, then claim blocks of
+	// characters from nextCharacter until there are none left
+	std::vector<std::thread> workers;
+	std::mutex poolMutex;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+	unsigned long generation;
+	unsigned busyWorkers;
+	bool stopping;
+	std::atomic<int> nextCharacter;
+	float stepSeconds;
+	}; // class Crowd
+
+#endif
@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	GaitTrack.cpp
+//	------------------------
+//
+//	Which feet are planted on each frame of a clip, and
+//	how far through its stride each frame is, worked out
+//	once when the clip loads. A foot is planted while its
+//	toe is both low and nearly still over the ground (as
+//	the character is moved by root motion); the stride
+//	starts each time the left foot comes down, and the
+//	phase runs evenly from 0 to 1 until it comes down
+//	again. Both are kept as a byte per frame, so syncing
+//	two clips on their phase is a lookup in each.
+//
+///////////////////////////////////////////////////
+
+#include "GaitTrack.h"
+#include "BVHData.h"
+#include "Pose.h"
+
+#include <algorithm>
+#include <math.h>
+
+// a toe is still while it moves at under this share of its fastest
+static const float stillFraction = 0.15f;
+// and low while it is in this share of its range of heights above its lowest
+static const float lowFraction = 0.5f;
+// a toe that stays low through a break in its contact shorter than this was never
+// lifted (root motion switching to the other foot can make it seem to slide)
+static const float bridgeSeconds = 0.1f;
+
+// find the contacts and phase of every frame of a clip
+GaitTrack::GaitTrack(const BVHData &clip)
+	: frameCount(clip.frame_count),
+	frameTime(clip.frame_time),
+	contacts(clip.frame_count, 0),
+	phases(clip.frame_count, 0)
+	{ // constructor
+	// each foot touches the ground at its toe (or at the ankle, on a rig without toes)
+	int toes[2] = { clip.skeleton.FindJointContaining("LeftToeBase"), clip.skeleton.FindJointContaining("RightToeBase") };
+	const char *ankles[2] = { "LeftFoot", "RightFoot" };
+	for (int foot = 0; foot < 2; foot++)
+		if (toes[foot] < 0)
+			toes[foot] = clip.skeleton.FindJointContaining(ankles[foot]);
+	if (frameCount < 2 || toes[0] < 0 || toes[1] < 0)
+		return;
+
+	// each toe's height, and its speed over the ground as the character is moved by root
+	// motion (the last frame, which the loop leaves with a turn, is measured from the one
+	// before it)
+	std::vector<float> heights((size_t) frameCount * 2), speeds((size_t) frameCount * 2);
+	std::vector<Cartesian3> places((size_t) frameCount * 2);
+	Pose pose;
+	for (int frame = 0; frame < frameCount; frame++)
+		{ // per frame
+		EvaluateFrame(clip, frame, pose);
+		for (int foot = 0; foot < 2; foot++)
+			{ // per foot
+			places[frame * 2 + foot] = pose.Position(toes[foot]);
+			heights[frame * 2 + foot] = pose.ClipPosition(toes[foot]).y;
+			} // per foot
+		} // per frame
+	for (int frame = 0; frame < frameCount; frame++)
+		{ // per frame
+		int from = std::min(frame, frameCount - 2);
+		for (int foot = 0; foot < 2; foot++)
+			{ // per foot
+			Cartesian3 step = places[(from + 1) * 2 + foot] - places[from * 2 + foot] + clip.RootMotion(from).translation;
+			step.y = 0.0f;
+			speeds[frame * 2 + foot] = step.length() / frameTime;
+			} // per foot
+		} // per frame
+
+	// a foot is planted while its toe is low and still, for this clip's heights and speeds
+	for (int foot = 0; foot < 2; foot++)
+		{ // per foot
+		float lowest = heights[foot], highest = heights[foot], fastest = 0.0f;
+		for (int frame = 0; frame < frameCount; frame++)
+			{ // per frame
+			lowest = std::min(lowest, heights[frame * 2 + foot]);
+			highest = std::max(highest, heights[frame * 2 + foot]);
+			fastest = std::max(fastest, speeds[frame * 2 + foot]);
+			} // per frame
+		float low = lowest + lowFraction * (highest - lowest);
+		uint8_t planted = foot == 0 ? leftPlanted : rightPlanted;
+		for (int frame = 0; frame < frameCount; frame++)
+			if (heights[frame * 2 + foot] <= low && speeds[frame * 2 + foot] <= stillFraction * fastest)
+				contacts[frame] |= planted;
+		// then short breaks in which the toe stays low are closed, looping round
+		for (int start = 0; start < frameCount; start++)
+			{ // per frame
+			if (!(contacts[start] & planted) || (contacts[(start + 1) % frameCount] & planted))
+				continue;
+			// a break starts after this frame: find where it ends, and whether the toe rose
+			int length = 0;
+			bool lifted = false;
+			for (int frame = (start + 1) % frameCount; !(contacts[frame] & planted); frame = (frame + 1) % frameCount)
+				{ // per frame of the break
+				lifted = lifted || heights[frame * 2 + foot] > low;
+				length++;
+				} // per frame of the break
+			if (lifted || length * frameTime >= bridgeSeconds)
+				continue;
+			for (int step = 1; step <= length; step++)
+				contacts[(start + step) % frameCount] |= planted;
+			} // per frame
+		} // per foot
+
+	// a stride starts on each frame the left foot comes down, looping round
+	for (int frame = 0; frame < frameCount; frame++)
+		if ((contacts[frame] & leftPlanted) && !(contacts[(frame + frameCount - 1) % frameCount] & leftPlanted))
+			strideStarts.push_back(frame);
+
+	// and the phase runs evenly through each stride to the start of the next
+	int strides = (int) strideStarts.size();
+	for (int stride = 0; stride < strides; stride++)
+		{ // per stride
+		int start = strideStarts[stride];
+		int length = stride + 1 < strides ? strideStarts[stride + 1] - start : strideStarts[0] + frameCount - start;
+		for (int step = 0; step < length; step++)
+			{ // per frame
+			int quantized = (int) lroundf(256.0f * step / length);
+			phases[(start + step) % frameCount] = (uint8_t) std::min(quantized, 255);
+			} // per frame
+		} // per stride
+	} // constructor
+
+// whether the clip steps at all
+bool GaitTrack::HasPhase() const
+	{ // HasPhase()
+	return !strideStarts.empty();
+	} // HasPhase()
+
+// the feet planted on a frame
+uint8_t GaitTrack::Contacts(int frame) const
+	{ // Contacts()
+	if (frameCount == 0)
+		return 0;
+	frame %= frameCount;
+	return contacts[frame < 0 ? frame + frameCount : frame];
+	} // Contacts()
+
+// how far through its stride the clip is at a time
+float GaitTrack::Phase(float time) const
+	{ // Phase()
+	if (!HasPhase() || frameTime <= 0.0f)
+		return 0.0f;
+	float frames = fmodf(time / frameTime, (float) frameCount);
+	if (frames < 0.0f)
+		frames += frameCount;
+	int frame = std::min((int) frames, frameCount - 1);
+	float from = phases[frame] / 256.0f;
+	float to = phases[(frame + 1) % frameCount] / 256.0f;
+	// a new stride starts back at 0
+	if (to < from)
+		to += 1.0f;
+	float phase = from + (to - from) * (frames - frame);
+	return phase - floorf(phase);
+	} // Phase()
+
+// the first time in the clip at which it is a phase through its stride
+float GaitTrack::TimeAtPhase(float phase) const
+	{ // TimeAtPhase()
+	if (!HasPhase())
+		return 0.0f;
+	phase -= floorf(phase);
+	for (int frame = 0; frame < frameCount; frame++)
+		{ // per frame
+		float from = phases[frame] / 256.0f;
+		float to = phases[(frame + 1) % frameCount] / 256.0f;
+		if (to < from)
+			to += 1.0f;
+		// the phase wanted, on from this frame's
+		float wanted = phase < from ? phase + 1.0f : phase;
+		if (wanted < to)
+			return (frame + (wanted - from) / (to - from)) * frameTime;
+		} // per frame
+	return 0.0f;
+	} // TimeAtPhase()
+
+// the seconds the stride under way at a time takes
+float GaitTrack::StrideSeconds(float time) const
+	{ // StrideSeconds()
+	if (!HasPhase() || frameTime <= 0.0f)
+		return frameCount * frameTime;
+	float frames = fmodf(time / frameTime, (float) frameCount);
+	if (frames < 0.0f)
+		frames += frameCount;
+	// the last stride to start by then, which before the first start is the one that
+	// started on the loop before
+	int strides = (int) strideStarts.size();
+	int stride = (int) (std::upper_bound(strideStarts.begin(), strideStarts.end(), (int) frames) - strideStarts.begin()) - 1;
+	if (stride < 0)
+		stride = strides - 1;
+	int start = strideStarts[stride];
+	int end = stride + 1 < strides ? strideStarts[stride + 1] : strideStarts[0] + frameCount;
+	return (end - start) * frameTime;
+	} // StrideSeconds()
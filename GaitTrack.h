@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	GaitTrack.h
+//	------------------------
+//
+//	Which feet are planted on each frame of a clip, and
+//	how far through its stride each frame is, worked out
+//	once when the clip loads. A foot is planted while its
+//	toe is both low and nearly still over the ground (as
+//	the character is moved by root motion); the stride
+//	starts each time the left foot comes down, and the
+//	phase runs evenly from 0 to 1 until it comes down
+//	again. Both are kept as a byte per frame, so syncing
+//	two clips on their phase is a lookup in each.
+//
+///////////////////////////////////////////////////
+
+#ifndef _GAITTRACK_H
+#define _GAITTRACK_H
+
+#include <cstdint>
+#include <vector>
+
+class BVHData;
+
+class GaitTrack
+	{ // class GaitTrack
+	public:
+	// the bits of a frame's contacts
+	static const uint8_t leftPlanted = 1;
+	static const uint8_t rightPlanted = 2;
+
+	// find the contacts and phase of every frame of a clip held in memory or mapped
+	explicit GaitTrack(const BVHData &clip);
+
+	// whether the clip steps at all: false for a clip in which the left foot never
+	// comes down, which then has no phase
+	bool HasPhase() const;
+
+	// the feet planted on a frame (looping round)
+	uint8_t Contacts(int frame) const;
+
+	// how far through its stride the clip is at a time in seconds (looping round), from
+	// 0 up to 1; 0 if it has no phase
+	float Phase(float time) const;
+
+	// the first time in the clip at which it is a phase through its stride; 0 if it has
+	// no phase
+	float TimeAtPhase(float phase) const;
+
+	// the seconds the stride under way at a time takes (the clip's length if it has no
+	// phase)
+	float StrideSeconds(float time) const;
+
+	private:
+	// the clip's frames and frame time
+	int frameCount;
+	float frameTime;
+
+	// each frame's contacts, and its phase in 256ths of a stride
+	std::vector<uint8_t> contacts;
+	std::vector<uint8_t> phases;
+
+	// the frame each stride starts on, in order
+	std::vector<int> strideStarts;
+	}; // class GaitTrack
+
+#endif
@@ -21,7 +21,8 @@
 #include "Cartesian3.h"
 
 // the class - we will rely on POD for sending to GPU
-class Homogeneous4
+// (aligned to 16 bytes so that Matrix4 can load it as one SIMD register)
+class alignas(16) Homogeneous4
     { // Homogeneous4
     public:
     // the coordinates
@@ -100,31 +100,31 @@ void HomogeneousFaceSurface::ComputeUnitNormalVectors()
 // routine to render
 void HomogeneousFaceSurface::Render(Matrix4 &viewMatrix)
 	{ // HomogeneousFaceSurface::Render()
+	// transform every vertex in one batch
+	viewVertices.resize(vertices.size());
+	viewMatrix.Transform(vertices.data(), viewVertices.data(), vertices.size());
+
+	// normal vector is tricky because we need NOT to apply the translation component
+	// so we create a temporary matrix and zero its translation elements
+	Matrix4 normalMatrix = viewMatrix;
+	normalMatrix[0][3] = normalMatrix[1][3] = normalMatrix[2][3] = 0.0;
+
+	// now we multiply to get the correct normals
+	viewNormals.resize(normals.size());
+	normalMatrix.Transform(normals.data(), viewNormals.data(), normals.size());
+
 	// walk through the faces rendering each one
 	glBegin(GL_TRIANGLES);
 	
 	// we loop through all of the triangles
 	for (int triangle = 0; triangle < (int) normals.size(); triangle++)
 		{ // per triangle
-		// retrieve the vertices and the normal
-		Homogeneous4 vertexP 	= viewMatrix * vertices[3 * triangle		];
-		Homogeneous4 vertexQ 	= viewMatrix * vertices[3 * triangle + 1	];
-		Homogeneous4 vertexR 	= viewMatrix * vertices[3 * triangle + 2	];
-
-		// normal vector is tricky because we need NOT to apply the translation component
-		// so we create a temporary matrix and zero its translation elements
-		Matrix4 normalMatrix = viewMatrix;
-		normalMatrix[0][3] = normalMatrix[1][3] = normalMatrix[2][3] = 0.0;
-		
-		// now we multiply to get the correct normal		
-		Homogeneous4 normal 	= normalMatrix * normals[triangle];
-		
 		// this works because C++ guarantees that the POD data is in exactly
 		// the order stated in the class with no padding.
-		glNormal3fv(&normal.x);
-		glVertex4fv(&vertexP.x);
-		glVertex4fv(&vertexQ.x);
-		glVertex4fv(&vertexR.x);
+		glNormal3fv(&viewNormals[triangle].x);
+		glVertex4fv(&viewVertices[3 * triangle	].x);
+		glVertex4fv(&viewVertices[3 * triangle + 1].x);
+		glVertex4fv(&viewVertices[3 * triangle + 2].x);
 		} // per triangle
 	
 	glEnd();
@@ -34,6 +34,11 @@ class HomogeneousFaceSurface
 	// vector to hold corresponding normal vectors
 	std::vector<Homogeneous4> normals;
 
+	// the vertices and normals in view space, filled by Render() each frame
+	// (kept between frames so that rendering does not allocate)
+	std::vector<Homogeneous4> viewVertices;
+	std::vector<Homogeneous4> viewNormals;
+
 	// constructor will initialise to safe values
 	HomogeneousFaceSurface();
 	
@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Inertializer.cpp
+//	------------------------
+//
+//	An inertialized transition: at the switch to a new
+//	pose it records how far, and how fast, each joint of
+//	the pose shown last is from the new one, then lets
+//	that offset die away over a fraction of a second with
+//	a polynomial that leaves the joint's velocity and
+//	acceleration continuous and does not overshoot. Only
+//	the new pose is evaluated while it does, so a
+//	transition costs one pose and a rotation per joint.
+//
+///////////////////////////////////////////////////
+
+#include "Inertializer.h"
+
+#include <algorithm>
+#include <math.h>
+
+// offsets smaller than this (radians, or clip units for the root) are not worth decaying
+static const float negligibleOffset = 1.0e-5f;
+
+// an inertializer with no transition under way
+Inertializer::Inertializer(float seconds)
+	: duration(seconds),
+	elapsed(0.0f),
+	end(0.0f),
+	shownStep(0.0f),
+	sinceShown(0.0f),
+	shownCount(0)
+	{ // constructor
+	root.end = 0.0f;
+	} // constructor
+
+// fit a decay to an offset and its rate of change
+Inertializer::Decay Inertializer::Fit(const Cartesian3 &axis, float offset, float velocity, float seconds)
+	{ // Fit()
+	Decay decay;
+	decay.axis = axis;
+	std::fill(decay.coefficients, decay.coefficients + 6, 0.0f);
+	decay.end = 0.0f;
+	if (offset < negligibleOffset || seconds <= 0.0f)
+		return decay;
+	// an offset already growing would overshoot if its velocity were kept, so it starts still
+	velocity = std::min(velocity, 0.0f);
+	// and one shrinking fast ends sooner, so that it reaches zero without passing it
+	float t1 = seconds;
+	if (velocity < 0.0f)
+		t1 = std::min(t1, -5.0f * offset / velocity);
+	// the starting acceleration that brings it in without overshoot
+	float acceleration = std::max(0.0f, (-8.0f * velocity * t1 - 20.0f * offset) / (t1 * t1));
+	float t2 = t1 * t1, t3 = t2 * t1;
+	decay.coefficients[0] = offset;
+	decay.coefficients[1] = velocity;
+	decay.coefficients[2] = 0.5f * acceleration;
+	decay.coefficients[3] = -(3.0f * acceleration * t2 + 12.0f * velocity * t1 + 20.0f * offset) / (2.0f * t3);
+	decay.coefficients[4] = (3.0f * acceleration * t2 + 16.0f * velocity * t1 + 30.0f * offset) / (2.0f * t3 * t1);
+	decay.coefficients[5] = -(acceleration * t2 + 6.0f * velocity * t1 + 12.0f * offset) / (2.0f * t3 * t2);
+	decay.end = t1;
+	return decay;
+	} // Fit()
+
+// the offset a decay has left at a time
+float Inertializer::Remaining(const Decay &decay, float time)
+	{ // Remaining()
+	if (time >= decay.end)
+		return 0.0f;
+	const float *c = decay.coefficients;
+	return c[0] + time * (c[1] + time * (c[2] + time * (c[3] + time * (c[4] + time * c[5]))));
+	} // Remaining()
+
+// start a transition from the pose last shown to a new one
+void Inertializer::Start(const Quaternion *target, const Cartesian3 &targetRoot, int jointCount)
+	{ // Start()
+	if (shownCount == 0 || (int) shown.size() != jointCount)
+		return;
+	// the offsets' velocities come from the two poses shown last, when there were two
+	bool moving = shownCount > 1 && shownStep > 0.0f && (int) shownBefore.size() == jointCount;
+	joints.resize(jointCount);
+	end = 0.0f;
+	for (int joint = 0; joint < jointCount; joint++)
+		{ // per joint
+		// the turn that takes the new rotation to the one shown, the short way round
+		Quaternion offset = shown[joint] * target[joint].conjugate();
+		if (offset.w < 0.0f)
+			offset = -offset;
+		Cartesian3 axis(offset.x, offset.y, offset.z);
+		float sinHalf = axis.length();
+		float angle = 2.0f * atan2f(sinHalf, offset.w);
+		axis = sinHalf > 0.0f ? axis / sinHalf : Cartesian3(1.0f, 0.0f, 0.0f);
+		// and the angle about the same axis the pose before stood at
+		float velocity = 0.0f;
+		if (moving)
+			{ // moving
+			Quaternion before = shownBefore[joint] * target[joint].conjugate();
+			if (before.w < 0.0f)
+				before = -before;
+			float angleBefore = 2.0f * atan2f(axis.dot(Cartesian3(before.x, before.y, before.z)), before.w);
+			velocity = (angle - angleBefore) / shownStep;
+			} // moving
+		joints[joint] = Fit(axis, angle, velocity, duration);
+		end = std::max(end, joints[joint].end);
+		} // per joint
+	// the root's offset is a distance along the line from the new position to the one shown
+	Cartesian3 offset = shownRoot - targetRoot;
+	float distance = offset.length();
+	Cartesian3 axis = distance > 0.0f ? offset / distance : Cartesian3(1.0f, 0.0f, 0.0f);
+	float velocity = moving ? (distance - axis.dot(shownRootBefore - targetRoot)) / shownStep : 0.0f;
+	root = Fit(axis, distance, velocity, duration);
+	end = std::max(end, root.end);
+	// the offsets were taken from the pose shown a step ago, so they have already had that long
+	// to move (starting from zero would hold the pose still for a frame)
+	elapsed = sinceShown;
+	} // Start()
+
+// move the transition on by a number of seconds
+void Inertializer::Advance(float seconds)
+	{ // Advance()
+	elapsed += seconds;
+	sinceShown += seconds;
+	} // Advance()
+
+// whether any offset is left to apply
+bool Inertializer::Active() const
+	{ // Active()
+	return elapsed < end;
+	} // Active()
+
+// add what is left of the offset onto a pose, which is then remembered as the one shown
+void Inertializer::Apply(Quaternion *rotations, Cartesian3 &rootPosition, int jointCount)
+	{ // Apply()
+	if (Active() && (int) joints.size() == jointCount)
+		{ // offset
+		for (int joint = 0; joint < jointCount; joint++)
+			{ // per joint
+			const Decay &decay = joints[joint];
+			if (elapsed >= decay.end)
+				continue;
+			float halfAngle = 0.5f * Remaining(decay, elapsed);
+			Cartesian3 axis = decay.axis * sinf(halfAngle);
+			rotations[joint] = Quaternion(axis.x, axis.y, axis.z, cosf(halfAngle)) * rotations[joint];
+			} // per joint
+		rootPosition = rootPosition + root.axis * Remaining(root, elapsed);
+		} // offset
+
+	// a pose shown again without time passing replaces the last, rather than counting twice
+	if (shownCount == 0 || sinceShown > 0.0f)
+		{ // new pose
+		std::swap(shown, shownBefore);
+		shownRootBefore = shownRoot;
+		shownStep = sinceShown;
+		shownCount = std::min(shownCount + 1, 2);
+		} // new pose
+	shown.assign(rotations, rotations + jointCount);
+	shownRoot = rootPosition;
+	sinceShown = 0.0f;
+	} // Apply()
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Inertializer.h
+//	------------------------
+//
+//	An inertialized transition: at the switch to a new
+//	pose it records how far, and how fast, each joint of
+//	the pose shown last is from the new one, then lets
+//	that offset die away over a fraction of a second with
+//	a polynomial that leaves the joint's velocity and
+//	acceleration continuous and does not overshoot. Only
+//	the new pose is evaluated while it does, so a
+//	transition costs one pose and a rotation per joint.
+//
+///////////////////////////////////////////////////
+
+#ifndef _INERTIALIZER_H
+#define _INERTIALIZER_H
+
+#include <vector>
+
+#include "Cartesian3.h"
+#include "Quaternion.h"
+
+class Inertializer
+	{ // class Inertializer
+	public:
+	// the longest an offset takes to die away, in seconds (a fast one may go sooner)
+	float duration;
+
+	// an inertializer with no transition under way
+	explicit Inertializer(float seconds = 0.3f);
+
+	// start a transition from the pose last shown to a new one, of one rotation per joint
+	// (does nothing if no pose has been shown yet)
+	void Start(const Quaternion *target, const Cartesian3 &targetRoot, int jointCount);
+
+	// move the transition on by a number of seconds
+	void Advance(float seconds);
+
+	// whether any offset is left to apply
+	bool Active() const;
+
+	// add what is left of the offset onto a pose, which is then remembered as the one
+	// shown (so that the next transition starts from it, at the speed it was moving)
+	void Apply(Quaternion *rotations, Cartesian3 &rootPosition, int jointCount);
+
+	private:
+	// one joint's offset: an angle about a fixed axis (or a distance along one, for the
+	// root) following x0 + v0 t + a0 t^2 / 2 + c3 t^3 + c4 t^4 + c5 t^5 until it reaches
+	// zero at the end
+	struct Decay
+		{ // struct Decay
+		Cartesian3 axis;
+		float coefficients[6];
+		float end;
+		}; // struct Decay
+
+	// fit a decay to an offset and its rate of change
+	static Decay Fit(const Cartesian3 &axis, float offset, float velocity, float seconds);
+
+	// the offset a decay has left at a time
+	static float Remaining(const Decay &decay, float time);
+
+	// the offsets of the transition under way, the seconds since it started, and when
+	// the last of them ends
+	std::vector<Decay> joints;
+	Decay root;
+	float elapsed;
+	float end;
+
+	// the last two poses shown, the seconds between them and the seconds since the last
+	std::vector<Quaternion> shown;
+	std::vector<Quaternion> shownBefore;
+	Cartesian3 shownRoot;
+	Cartesian3 shownRootBefore;
+	float shownStep;
+	float sinceShown;
+	int shownCount;
+	}; // class Inertializer
+
+#endif
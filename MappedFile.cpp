@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MappedFile.cpp
+//	------------------------
+//	
+//	A read-only view of a whole file mapped into memory,
+//	so that parsers can tokenise it in place
+//	
+///////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// constructor will initialise to an empty view
+MappedFile::MappedFile()
+	: data(nullptr),
+	size(0)
+#ifdef _WIN32
+	, fileHandle(nullptr),
+	mappingHandle(nullptr)
+#endif
+	{ // constructor
+	} // constructor
+
+// destructor unmaps the file
+MappedFile::~MappedFile()
+	{ // destructor
+	Close();
+	} // destructor
+
+// move constructor takes over the mapping
+MappedFile::MappedFile(MappedFile &&other) noexcept
+	: data(other.data),
+	size(other.size)
+#ifdef _WIN32
+	, fileHandle(other.fileHandle),
+	mappingHandle(other.mappingHandle)
+#endif
+	{ // move constructor
+	other.data = nullptr;
+	other.size = 0;
+#ifdef _WIN32
+	other.fileHandle = other.mappingHandle = nullptr;
+#endif
+	} // move constructor
+
+// move assignment releases this mapping and takes over the other
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+	{ // move assignment
+	if (this == &other)
+		return *this;
+	Close();
+	data = other.data;
+	size = other.size;
+	other.data = nullptr;
+	other.size = 0;
+#ifdef _WIN32
+	fileHandle = other.fileHandle;
+	mappingHandle = other.mappingHandle;
+	other.fileHandle = other.mappingHandle = nullptr;
+#endif
+	return *this;
+	} // move assignment
+
+// map the given file, returns true on success
+bool MappedFile::Open(const char *fileName)
+	{ // Open()
+	// drop any previous mapping
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+		{ // no size available
+		CloseHandle(file);
+		return false;
+		} // no size available
+	// an empty file is valid, but cannot be mapped
+	if (fileSize.QuadPart == 0)
+		{ // empty file
+		CloseHandle(file);
+		return true;
+		} // empty file
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+		{ // mapping failed
+		CloseHandle(file);
+		return false;
+		} // mapping failed
+	data = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+		{ // view failed
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+		} // view failed
+	size = (size_t) fileSize.QuadPart;
+	fileHandle = file;
+	mappingHandle = mapping;
+#else
+	int file = open(fileName, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat fileStatus;
+	if (fstat(file, &fileStatus) != 0)
+		{ // no size available
+		close(file);
+		return false;
+		} // no size available
+	// an empty file is valid, but mmap refuses zero-length mappings
+	if (fileStatus.st_size == 0)
+		{ // empty file
+		close(file);
+		return true;
+		} // empty file
+	void *pages = mmap(nullptr, (size_t) fileStatus.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	// the mapping keeps its own reference to the file
+	close(file);
+	if (pages == MAP_FAILED)
+		return false;
+	// we read front to back, so let the kernel read ahead aggressively
+	madvise(pages, (size_t) fileStatus.st_size, MADV_SEQUENTIAL);
+	data = (const char *) pages;
+	size = (size_t) fileStatus.st_size;
+#endif
+	return true;
+	} // Open()
+
+// tell the system a range is no longer needed
+void MappedFile::Release(size_t offset, size_t length) const
+	{ // Release()
+	if (data == nullptr || offset >= size)
+		return;
+	if (length > size - offset)
+		length = size - offset;
+#ifdef _WIN32
+	// unlocking pages that are not locked is how Windows drops them from the working set
+	VirtualUnlock((void *) (data + offset), length);
+#else
+	// only whole pages inside the range can be dropped
+	size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+	size_t first = (offset + pageSize - 1) / pageSize * pageSize;
+	size_t last = (offset + length) / pageSize * pageSize;
+	if (last > first)
+		madvise((void *) (data + first), last - first, MADV_DONTNEED);
+#endif
+	} // Release()
+
+// release the mapping
+void MappedFile::Close()
+	{ // Close()
+#ifdef _WIN32
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != nullptr)
+		CloseHandle(fileHandle);
+	fileHandle = mappingHandle = nullptr;
+#else
+	if (data != nullptr)
+		munmap((void *) data, size);
+#endif
+	data = nullptr;
+	size = 0;
+	} // Close()
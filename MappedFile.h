@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MappedFile.h
+//	------------------------
+//	
+//	A read-only view of a whole file mapped into memory,
+//	so that parsers can tokenise it in place
+//	
+///////////////////////////////////////////////////
+
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <cstddef>
+#include <string_view>
+
+class MappedFile
+	{ // class MappedFile
+	public:
+	// constructor will initialise to an empty view
+	MappedFile();
+
+	// destructor unmaps the file
+	~MappedFile();
+
+	// a mapping owns the pages, so it may be moved but not copied; the pages stay where
+	// they are, so pointers into them stay valid, and the moved-from view is left empty
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile &&other) noexcept;
+	MappedFile& operator=(MappedFile &&other) noexcept;
+
+	// map the given file, returns true on success
+	bool Open(const char *fileName);
+
+	// release the mapping
+	void Close();
+
+	// first byte of the file
+	const char *Data() const { return data; }
+
+	// size of the file in bytes
+	size_t Size() const { return size; }
+
+	// the whole file as a view
+	std::string_view View() const { return std::string_view(data, size); }
+
+	// tell the system a range is no longer needed, so its pages stop counting against us
+	// (they are read back in from the file if touched again)
+	void Release(size_t offset, size_t length) const;
+
+	private:
+	// start of the mapped pages (nullptr when nothing is mapped, as for an empty file)
+	const char *data;
+
+	// number of bytes mapped
+	size_t size;
+
+#ifdef _WIN32
+	// handles that keep the mapping alive
+	void *fileHandle;
+	void *mappingHandle;
+#endif
+	}; // class MappedFile
+
+#endif
@@ -12,9 +12,12 @@
 //  
 //  A minimal class for a homogeneous 4x4 matrix
 //  
-//  Note: the emphasis here is on clarity, not efficiency
-//  A number of the routines could be implemented more
-//  efficiently but aren't
+//  Note: the emphasis here is on clarity, not efficiency,
+//  except for the products, transpose and batch transform,
+//  which every joint and terrain vertex goes through each
+//  frame: these have SSE/AVX and NEON kernels, chosen by
+//  the instruction set the compiler targets (define
+//  MATRIX4_NO_SIMD to build the plain loops instead)
 //  
 ///////////////////////////////////////////////////
 
@@ -23,6 +26,24 @@
 #include "Matrix4.h"
 #include <math.h>
 
+// pick the widest kernels the compiler is building for
+#if !defined(MATRIX4_NO_SIMD)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MATRIX4_AVX
+#define MATRIX4_SSE
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MATRIX4_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MATRIX4_NEON
+#endif
+#endif
+
+// the kernels load rows and vectors as single registers
+static_assert(sizeof(Homogeneous4) == 4 * sizeof(float), "Homogeneous4 must be four packed floats");
+
 // constructor - default to the zero matrix
 Matrix4::Matrix4()
     { // default constructor
@@ -31,6 +52,11 @@ Matrix4::Matrix4()
             coordinates[row][col] = 0.0;
     } // default constructor
 
+// constructor for a result that is about to be overwritten, so is not zeroed
+Matrix4::Matrix4(Uninitialised)
+    { // uninitialised constructor
+    } // uninitialised constructor
+
 // equality operator
 bool Matrix4::operator ==(const Matrix4 &other) const
     { // operator ==()
@@ -77,18 +103,72 @@ Matrix4 Matrix4::operator *(float factor) const
 // multiplication is the only operator we use
 Homogeneous4 Matrix4::operator *(const Homogeneous4 &vector) const
     { // operator *()
-    // get a zero-initialised vector
     Homogeneous4 productVector;
-    
-    // now loop, adding products
-    for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            productVector[row] += coordinates[row][col] * vector[col];
-    
-    // return the result
+    Transform(&vector, &productVector, 1);
     return productVector;
     } // operator *()
 
+// transform a batch of vectors
+void Matrix4::Transform(const Homogeneous4 *in, Homogeneous4 *out, size_t count) const
+    { // Transform()
+    size_t vector = 0;
+#if defined(MATRIX4_SSE)
+    // the product is a sum of columns scaled by the vector's coordinates,
+    // so turn the rows into columns once for the whole batch
+    __m128 column0 = _mm_load_ps(coordinates[0]);
+    __m128 column1 = _mm_load_ps(coordinates[1]);
+    __m128 column2 = _mm_load_ps(coordinates[2]);
+    __m128 column3 = _mm_load_ps(coordinates[3]);
+    _MM_TRANSPOSE4_PS(column0, column1, column2, column3);
+#if defined(MATRIX4_AVX)
+    // two vectors at a time, one in each half of a register
+    __m256 wideColumn0 = _mm256_set_m128(column0, column0);
+    __m256 wideColumn1 = _mm256_set_m128(column1, column1);
+    __m256 wideColumn2 = _mm256_set_m128(column2, column2);
+    __m256 wideColumn3 = _mm256_set_m128(column3, column3);
+    for (; vector + 2 <= count; vector += 2)
+        { // per pair
+        __m256 pair = _mm256_loadu_ps(&in[vector].x);
+        __m256 product = _mm256_mul_ps(wideColumn0, _mm256_permute_ps(pair, 0x00));
+        product = _mm256_add_ps(product, _mm256_mul_ps(wideColumn1, _mm256_permute_ps(pair, 0x55)));
+        product = _mm256_add_ps(product, _mm256_mul_ps(wideColumn2, _mm256_permute_ps(pair, 0xAA)));
+        product = _mm256_add_ps(product, _mm256_mul_ps(wideColumn3, _mm256_permute_ps(pair, 0xFF)));
+        _mm256_storeu_ps(&out[vector].x, product);
+        } // per pair
+#endif
+    for (; vector < count; vector++)
+        { // per vector
+        __m128 value = _mm_load_ps(&in[vector].x);
+        __m128 product = _mm_mul_ps(column0, _mm_shuffle_ps(value, value, 0x00));
+        product = _mm_add_ps(product, _mm_mul_ps(column1, _mm_shuffle_ps(value, value, 0x55)));
+        product = _mm_add_ps(product, _mm_mul_ps(column2, _mm_shuffle_ps(value, value, 0xAA)));
+        product = _mm_add_ps(product, _mm_mul_ps(column3, _mm_shuffle_ps(value, value, 0xFF)));
+        _mm_store_ps(&out[vector].x, product);
+        } // per vector
+#elif defined(MATRIX4_NEON)
+    // a de-interleaving load turns the rows into columns
+    float32x4x4_t columns = vld4q_f32(&coordinates[0][0]);
+    for (; vector < count; vector++)
+        { // per vector
+        float32x4_t value = vld1q_f32(&in[vector].x);
+        float32x4_t product = vmulq_n_f32(columns.val[0], vgetq_lane_f32(value, 0));
+        product = vmlaq_n_f32(product, columns.val[1], vgetq_lane_f32(value, 1));
+        product = vmlaq_n_f32(product, columns.val[2], vgetq_lane_f32(value, 2));
+        product = vmlaq_n_f32(product, columns.val[3], vgetq_lane_f32(value, 3));
+        vst1q_f32(&out[vector].x, product);
+        } // per vector
+#else
+    for (; vector < count; vector++)
+        { // per vector
+        // copy first, in case the output overwrites the input
+        Homogeneous4 value = in[vector];
+        for (int row = 0; row < 4; row++)
+            out[vector][row] = coordinates[row][0] * value[0] + coordinates[row][1] * value[1]
+                               + coordinates[row][2] * value[2] + coordinates[row][3] * value[3];
+        } // per vector
+#endif
+    } // Transform()
+
 // and on Cartesian coordinates
 Cartesian3 Matrix4::operator *(const Cartesian3 &vector) const
     { // cartesian multiplication
@@ -133,34 +213,113 @@ Matrix4 Matrix4::operator -(const Matrix4 &other) const
 // multiplication operator
 Matrix4 Matrix4::operator *(const Matrix4 &other) const
     { // operator *()
-    // start with a zero matrix
-    Matrix4 productMatrix;
-    
-    // now loop, adding products
+    // every entry is written, so there is no need to start from zero
+    Matrix4 productMatrix(uninitialised);
+
+    // each row of the product is the rows of the other matrix, weighted by a row of this one
+#if defined(MATRIX4_AVX)
+    // two rows of the product at a time, one in each half of a register
+    __m256 otherRow0 = _mm256_broadcast_ps((const __m128 *) other.coordinates[0]);
+    __m256 otherRow1 = _mm256_broadcast_ps((const __m128 *) other.coordinates[1]);
+    __m256 otherRow2 = _mm256_broadcast_ps((const __m128 *) other.coordinates[2]);
+    __m256 otherRow3 = _mm256_broadcast_ps((const __m128 *) other.coordinates[3]);
+    for (int row = 0; row < 4; row += 2)
+        { // per pair of rows
+        __m256 rows = _mm256_loadu_ps(coordinates[row]);
+        __m256 product = _mm256_mul_ps(_mm256_permute_ps(rows, 0x00), otherRow0);
+        product = _mm256_add_ps(product, _mm256_mul_ps(_mm256_permute_ps(rows, 0x55), otherRow1));
+        product = _mm256_add_ps(product, _mm256_mul_ps(_mm256_permute_ps(rows, 0xAA), otherRow2));
+        product = _mm256_add_ps(product, _mm256_mul_ps(_mm256_permute_ps(rows, 0xFF), otherRow3));
+        _mm256_storeu_ps(productMatrix.coordinates[row], product);
+        } // per pair of rows
+#elif defined(MATRIX4_SSE)
+    __m128 otherRow0 = _mm_load_ps(other.coordinates[0]);
+    __m128 otherRow1 = _mm_load_ps(other.coordinates[1]);
+    __m128 otherRow2 = _mm_load_ps(other.coordinates[2]);
+    __m128 otherRow3 = _mm_load_ps(other.coordinates[3]);
     for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            for (int entry = 0; entry < 4; entry++)
-                productMatrix.coordinates[row][col] += coordinates[row][entry] * other.coordinates[entry][col];
-
+        { // per row
+        __m128 product = _mm_mul_ps(_mm_set1_ps(coordinates[row][0]), otherRow0);
+        product = _mm_add_ps(product, _mm_mul_ps(_mm_set1_ps(coordinates[row][1]), otherRow1));
+        product = _mm_add_ps(product, _mm_mul_ps(_mm_set1_ps(coordinates[row][2]), otherRow2));
+        product = _mm_add_ps(product, _mm_mul_ps(_mm_set1_ps(coordinates[row][3]), otherRow3));
+        _mm_store_ps(productMatrix.coordinates[row], product);
+        } // per row
+#elif defined(MATRIX4_NEON)
+    float32x4_t otherRow0 = vld1q_f32(other.coordinates[0]);
+    float32x4_t otherRow1 = vld1q_f32(other.coordinates[1]);
+    float32x4_t otherRow2 = vld1q_f32(other.coordinates[2]);
+    float32x4_t otherRow3 = vld1q_f32(other.coordinates[3]);
+    for (int row = 0; row < 4; row++)
+        { // per row
+        float32x4_t product = vmulq_n_f32(otherRow0, coordinates[row][0]);
+        product = vmlaq_n_f32(product, otherRow1, coordinates[row][1]);
+        product = vmlaq_n_f32(product, otherRow2, coordinates[row][2]);
+        product = vmlaq_n_f32(product, otherRow3, coordinates[row][3]);
+        vst1q_f32(productMatrix.coordinates[row], product);
+        } // per row
+#else
+    productMatrix = ScalarProduct(*this, other);
+#endif
     // return the result
     return productMatrix;
     } // operator *()
 
+// the same product without SIMD
+Matrix4 Matrix4::ScalarProduct(const Matrix4 &left, const Matrix4 &right)
+    { // ScalarProduct()
+    Matrix4 productMatrix(uninitialised);
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            productMatrix.coordinates[row][col] = left.coordinates[row][0] * right.coordinates[0][col]
+                                                  + left.coordinates[row][1] * right.coordinates[1][col]
+                                                  + left.coordinates[row][2] * right.coordinates[2][col]
+                                                  + left.coordinates[row][3] * right.coordinates[3][col];
+    return productMatrix;
+    } // ScalarProduct()
+
 // matrix transpose
 Matrix4 Matrix4::transpose() const
     { // transpose()
-    // start with a zero matrix
-    Matrix4 transposeMatrix;
-    
-    // now loop, adding products
+    Matrix4 transposeMatrix(uninitialised);
+#if defined(MATRIX4_SSE)
+    __m128 row0 = _mm_load_ps(coordinates[0]);
+    __m128 row1 = _mm_load_ps(coordinates[1]);
+    __m128 row2 = _mm_load_ps(coordinates[2]);
+    __m128 row3 = _mm_load_ps(coordinates[3]);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    _mm_store_ps(transposeMatrix.coordinates[0], row0);
+    _mm_store_ps(transposeMatrix.coordinates[1], row1);
+    _mm_store_ps(transposeMatrix.coordinates[2], row2);
+    _mm_store_ps(transposeMatrix.coordinates[3], row3);
+#elif defined(MATRIX4_NEON)
+    // a de-interleaving load reads the columns
+    float32x4x4_t columns = vld4q_f32(&coordinates[0][0]);
+    for (int row = 0; row < 4; row++)
+        vst1q_f32(transposeMatrix.coordinates[row], columns.val[row]);
+#else
     for (int row = 0; row < 4; row++)
         for (int col = 0; col < 4; col++)
             transposeMatrix.coordinates[row][col] = coordinates[col][row];
-
+#endif
     // return the result
     return transposeMatrix;
     } // transpose()
 
+// name of the instruction set the kernels were built for
+const char *Matrix4::Implementation()
+    { // Implementation()
+#if defined(MATRIX4_AVX)
+    return "AVX";
+#elif defined(MATRIX4_SSE)
+    return "SSE";
+#elif defined(MATRIX4_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+    } // Implementation()
+
 // returns a column-major array of 16 values
 // for use with OpenGL
 columnMajorMatrix Matrix4::columnMajor() const
@@ -176,7 +335,7 @@ columnMajorMatrix Matrix4::columnMajor() const
     } // columnMajor()
 
 // routine that returns a row vector as a Homogeneous4
-Homogeneous4 Matrix4::row(int rowNum)
+Homogeneous4 Matrix4::row(int rowNum) const
 	{ // row()
 	// temporary variable
 	Homogeneous4 returnValue;
@@ -188,7 +347,7 @@ Homogeneous4 Matrix4::row(int rowNum)
 	} // row()
 
 // and similar for a column
-Homogeneous4 Matrix4::column(int colNum)
+Homogeneous4 Matrix4::column(int colNum) const
 	{ // column()
 	// temporary variable
 	Homogeneous4 returnValue;
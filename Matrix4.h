@@ -18,6 +18,7 @@
 #ifndef MATRIX4_H
 #define MATRIX4_H
 
+#include <cstddef>
 #include <iostream>
 #include "Cartesian3.h"
 #include "Homogeneous4.h"
@@ -42,8 +43,8 @@ class columnMajorMatrix
 class Matrix4
     { // Matrix4
     public:
-    // the coordinates
-    float coordinates[4][4];
+    // the coordinates (each row starts on 16 bytes, so it loads as one SIMD register)
+    alignas(16) float coordinates[4][4];
 
     // constructor - default to the zero matrix
     Matrix4();
@@ -69,6 +70,10 @@ class Matrix4
     // and on Cartesian coordinates
     Cartesian3 operator *(const Cartesian3 &vector) const;
 
+    // transform a batch of vectors: out[i] = (*this) * in[i]
+    // (out may be the same array as in)
+    void Transform(const Homogeneous4 *in, Homogeneous4 *out, size_t count) const;
+
     // matrix operations
     // addition operator
     Matrix4 operator +(const Matrix4 &other) const;
@@ -76,6 +81,10 @@ class Matrix4
     Matrix4 operator -(const Matrix4 &other) const;
     // multiplication operator
     Matrix4 operator *(const Matrix4 &other) const; 
+
+    // the same product without SIMD, which the operator falls back on when there are no
+    // SIMD kernels (kept callable in every build, so the two can be timed side by side)
+    static Matrix4 ScalarProduct(const Matrix4 &left, const Matrix4 &right);
     
     // matrix transpose
     Matrix4 transpose() const;
@@ -85,10 +94,10 @@ class Matrix4
     columnMajorMatrix columnMajor() const;
 
 	// routine that returns a row vector as a Homogeneous4
-	Homogeneous4 row(int rowNum);
+	Homogeneous4 row(int rowNum) const;
 	
 	// and similar for a column
-	Homogeneous4 column(int colNum);
+	Homogeneous4 column(int colNum) const;
 
     // methods that return particular matrices
     static Matrix4 Zero();
@@ -103,6 +112,14 @@ class Matrix4
     static Matrix4 RotateZ(float degrees);
 
     static Matrix4 GetRotation(const Cartesian3& vector1, const Cartesian3& vector2);
+
+    // name of the instruction set the products and transforms were built for
+    static const char *Implementation();
+
+    private:
+    // a result that is about to be overwritten, so is not worth zeroing
+    enum Uninitialised { uninitialised };
+    explicit Matrix4(Uninitialised);
     }; // Matrix4
 
 // scalar operations
@@ -0,0 +1,385 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MotionMatching.cpp
+//	------------------------
+//
+//	A database of features of every frame of a set of
+//	clips, searched for the frame that best carries on
+//	from the one playing towards a desired trajectory.
+//	Each frame is described by where the root will be,
+//	and which way it will face, over the next second,
+//	where the feet are and how fast they and the hips
+//	move; every feature is scaled so that each group
+//	counts the same. The search walks a KD-tree of the
+//	frames, skipping any branch whose bounding box is no
+//	nearer than the best frame so far, and a plain SIMD
+//	scan of every frame gives the same answer for checking.
+//
+///////////////////////////////////////////////////
+
+#include "MotionMatching.h"
+#include "Matrix4.h"
+#include "Pose.h"
+#include "PoseKernels.h"
+
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+// the most rows a leaf of the tree holds
+static const int leafRows = 16;
+
+// the deepest the tree can be: far more than halving even billions of rows needs
+static const int maxTreeDepth = 64;
+
+// steps a second when integrating a constant trajectory
+static const int trajectorySteps = 120;
+
+// the features fall into groups that are scaled to count the same: the trajectory's
+// places and facings, the feet's places and velocities, and the hips' velocity
+static const int groupCount = 5;
+static int FeatureGroup(int feature)
+	{ // FeatureGroup()
+	if (feature < MotionDatabase::trajectoryFeatures)
+		return feature % 4 < 2 ? 0 : 1;
+	feature -= MotionDatabase::trajectoryFeatures;
+	return feature < 6 ? 2 : feature < 12 ? 3 : 4;
+	} // FeatureGroup()
+
+// the trajectory a clip's root motion takes the character along from a frame
+static void ClipTrajectory(const BVHData &clip, int frame, float *trajectory)
+	{ // ClipTrajectory()
+	Cartesian3 place;
+	float yaw = 0.0f, done = 0.0f;
+	for (int point = 0; point < MotionDatabase::trajectoryPoints; point++)
+		{ // per point
+		// the part of each frame's step the time to this point covers, as the character moves
+		float framesAhead = (point + 1) / (float) MotionDatabase::trajectoryPoints / clip.frame_time;
+		while (framesAhead - done > 1.0e-4f)
+			{ // per frame
+			float whole = floorf(done + 1.0e-4f);
+			float portion = std::min(whole + 1.0f - done, framesAhead - done);
+			const RootMotionDelta &step = clip.RootMotion((frame + (int) whole) % clip.frame_count);
+			place = place + Matrix4::RotateZ(yaw) * (clipToScene * step.translation * portion);
+			yaw += step.yaw * portion;
+			done += portion;
+			} // per frame
+		Cartesian3 facing = Matrix4::RotateZ(yaw) * (clipToScene * Cartesian3(0.0f, 0.0f, 1.0f));
+		float *sample = trajectory + point * 4;
+		sample[0] = place.x;
+		sample[1] = place.y;
+		sample[2] = facing.x;
+		sample[3] = facing.y;
+		} // per point
+	} // ClipTrajectory()
+
+// the trajectory of moving at a constant velocity while turning at a constant rate
+void MotionDatabase::ConstantTrajectory(const Cartesian3 &velocity, float turnRate, float *trajectory)
+	{ // ConstantTrajectory()
+	Cartesian3 place;
+	float yaw = 0.0f;
+	float stepSeconds = 1.0f / trajectorySteps;
+	int step = 0;
+	for (int point = 0; point < trajectoryPoints; point++)
+		{ // per point
+		// moving, then turning, a step at a time, as root motion moves the character
+		for (int end = (point + 1) * trajectorySteps / trajectoryPoints; step < end; step++)
+			{ // per step
+			place = place + Matrix4::RotateZ(yaw) * (clipToScene * velocity * stepSeconds);
+			yaw += turnRate * stepSeconds;
+			} // per step
+		Cartesian3 facing = Matrix4::RotateZ(yaw) * (clipToScene * Cartesian3(0.0f, 0.0f, 1.0f));
+		float *sample = trajectory + point * 4;
+		sample[0] = place.x;
+		sample[1] = place.y;
+		sample[2] = facing.x;
+		sample[3] = facing.y;
+		} // per point
+	} // ConstantTrajectory()
+
+// the average velocity and turn rate of a clip's root motion
+void MotionDatabase::ClipMotion(const BVHData &clip, Cartesian3 &velocity, float &turnRate)
+	{ // ClipMotion()
+	velocity = Cartesian3(0.0f, 0.0f, 0.0f);
+	turnRate = 0.0f;
+	float duration = clip.frame_count * clip.frame_time;
+	if (duration <= 0.0f)
+		return;
+	for (int frame = 0; frame < clip.frame_count; frame++)
+		{ // per frame
+		velocity = velocity + clip.RootMotion(frame).translation;
+		turnRate += clip.RootMotion(frame).yaw;
+		} // per frame
+	velocity = velocity / duration;
+	turnRate /= duration;
+	} // ClipMotion()
+
+// describe every frame of a set of clips, and bound them for searching
+void MotionDatabase::Build(const std::vector<ClipHandle> &newClips)
+	{ // Build()
+	// a clip's trajectory and velocities are measured per second, so a clip with no
+	// time between its frames would never finish its trajectory and would divide by zero
+	clips.clear();
+	for (const ClipHandle &clip : newClips)
+		if (clip && clip->frame_count > 0 && clip->frame_time > 0.0f)
+			clips.push_back(clip);
+	clipIndex.clear();
+	firstRow.assign(clips.size() + 1, 0);
+	for (size_t clip = 0; clip < clips.size(); clip++)
+		{ // per clip
+		clipIndex[clips[clip].get()] = (int) clip;
+		firstRow[clip + 1] = firstRow[clip] + clips[clip]->frame_count;
+		} // per clip
+	int rowCount = RowCount();
+
+	// every frame's features as they are measured
+	std::vector<float> raw((size_t) rowCount * featureCount);
+	Pose pose;
+	for (size_t clip = 0; clip < clips.size(); clip++)
+		{ // per clip
+		const BVHData &data = *clips[clip];
+		int feet[2] = { data.skeleton.FindJointContaining("LeftFoot"), data.skeleton.FindJointContaining("RightFoot") };
+		// the feet and hips of every frame, relative to the root and facing the way it faces
+		// (a foot the rig lacks stays at the origin, so its place and velocity are zero)
+		std::vector<Cartesian3> places((size_t) data.frame_count * 3);
+		for (int frame = 0; frame < data.frame_count; frame++)
+			{ // per frame
+			EvaluateFrame(data, frame, pose);
+			Matrix4 facing = Matrix4::RotateY(-data.RootHeading(data.FrameQuaternions(frame)));
+			for (int foot = 0; foot < 2; foot++)
+				places[frame * 3 + foot] = feet[foot] < 0 ? Cartesian3() : facing * pose.Position(feet[foot]);
+			places[frame * 3 + 2] = facing * pose.Position(0);
+			} // per frame
+		for (int frame = 0; frame < data.frame_count; frame++)
+			{ // per frame
+			float *row = &raw[(size_t) (firstRow[clip] + frame) * featureCount];
+			ClipTrajectory(data, frame, row);
+			// the velocities are to the next frame, looping round; the hips also carry the
+			// root motion
+			const Cartesian3 *now = &places[frame * 3];
+			const Cartesian3 *next = &places[((frame + 1) % data.frame_count) * 3];
+			Cartesian3 hips = (next[2] - now[2] + data.RootMotion(frame).translation) / data.frame_time;
+			Cartesian3 pieces[5] = { now[0], now[1], (next[0] - now[0]) / data.frame_time, (next[1] - now[1]) / data.frame_time, hips };
+			for (int piece = 0; piece < 5; piece++)
+				for (int axis = 0; axis < 3; axis++)
+					row[trajectoryFeatures + piece * 3 + axis] = pieces[piece][axis];
+			} // per frame
+		} // per clip
+
+	// each feature's mean, and each group's spread (the root mean square of its features'
+	// standard deviations), which every feature in it is divided by
+	mean.assign(stride, 0.0f);
+	scale.assign(stride, 0.0f);
+	std::vector<double> sum(featureCount, 0.0), sumSquares(featureCount, 0.0);
+	for (int row = 0; row < rowCount; row++)
+		for (int feature = 0; feature < featureCount; feature++)
+			{ // per feature
+			double value = raw[(size_t) row * featureCount + feature];
+			sum[feature] += value;
+			sumSquares[feature] += value * value;
+			} // per feature
+	double groupVariance[groupCount] = { 0.0 };
+	int groupSize[groupCount] = { 0 };
+	for (int feature = 0; feature < featureCount && rowCount > 0; feature++)
+		{ // per feature
+		mean[feature] = (float) (sum[feature] / rowCount);
+		groupVariance[FeatureGroup(feature)] += std::max(0.0, sumSquares[feature] / rowCount - mean[feature] * (double) mean[feature]);
+		groupSize[FeatureGroup(feature)]++;
+		} // per feature
+	for (int feature = 0; feature < featureCount; feature++)
+		{ // per feature
+		int group = FeatureGroup(feature);
+		double spread = sqrt(groupVariance[group] / groupSize[group]);
+		scale[feature] = spread > 1.0e-6 ? (float) (1.0 / spread) : 0.0f;
+		} // per feature
+
+	// the scaled features, padded with zeros
+	features.Resize(0);
+	features.Resize((size_t) rowCount * stride);
+	for (int row = 0; row < rowCount; row++)
+		for (int feature = 0; feature < featureCount; feature++)
+			features.Data()[(size_t) row * stride + feature] = (raw[(size_t) row * featureCount + feature] - mean[feature]) * scale[feature];
+
+	// then the tree, splitting runs of rows in half down to the leaves
+	treeRow.resize(rowCount);
+	for (int row = 0; row < rowCount; row++)
+		treeRow[row] = row;
+	nodes.clear();
+	nodes.push_back(Node());
+	Split(0, 0, rowCount);
+	nodeLow.Resize(0);
+	nodeHigh.Resize(0);
+	nodeLow.Resize(nodes.size() * stride);
+	nodeHigh.Resize(nodes.size() * stride);
+	treeFeatures.Resize(0);
+	treeFeatures.Resize((size_t) rowCount * stride);
+	for (int place = 0; place < rowCount; place++)
+		std::copy(features.Data() + (size_t) treeRow[place] * stride, features.Data() + (size_t) (treeRow[place] + 1) * stride,
+			treeFeatures.Data() + (size_t) place * stride);
+	for (size_t node = 0; node < nodes.size(); node++)
+		{ // per node
+		float *low = nodeLow.Data() + node * stride;
+		float *high = nodeHigh.Data() + node * stride;
+		std::fill(low, low + stride, std::numeric_limits<float>::max());
+		std::fill(high, high + stride, -std::numeric_limits<float>::max());
+		for (int place = nodes[node].first; place < nodes[node].first + nodes[node].count; place++)
+			for (int feature = 0; feature < stride; feature++)
+				{ // per feature
+				float value = treeFeatures.Data()[(size_t) place * stride + feature];
+				low[feature] = std::min(low[feature], value);
+				high[feature] = std::max(high[feature], value);
+				} // per feature
+		} // per node
+	} // Build()
+
+// make a node for a run of rows in tree order, splitting it if it is big enough
+void MotionDatabase::Split(int node, int first, int count)
+	{ // Split()
+	nodes[node].first = first;
+	nodes[node].count = count;
+	nodes[node].children = -1;
+	if (count <= leafRows)
+		return;
+	// split across the feature the rows spread furthest along, at its median
+	int widest = 0;
+	float widestSpread = -1.0f;
+	for (int feature = 0; feature < featureCount; feature++)
+		{ // per feature
+		float low = std::numeric_limits<float>::max(), high = -low;
+		for (int place = first; place < first + count; place++)
+			{ // per row
+			float value = features.Data()[(size_t) treeRow[place] * stride + feature];
+			low = std::min(low, value);
+			high = std::max(high, value);
+			} // per row
+		if (high - low > widestSpread)
+			{ // wider
+			widestSpread = high - low;
+			widest = feature;
+			} // wider
+		} // per feature
+	int half = count / 2;
+	std::nth_element(treeRow.begin() + first, treeRow.begin() + first + half, treeRow.begin() + first + count, [this, widest](int left, int right)
+		{ // by the widest feature
+		return features.Data()[(size_t) left * stride + widest] < features.Data()[(size_t) right * stride + widest];
+		}); // by the widest feature
+	int children = (int) nodes.size();
+	nodes[node].children = children;
+	nodes.push_back(Node());
+	nodes.push_back(Node());
+	Split(children, first, half);
+	Split(children + 1, first + half, count - half);
+	} // Split()
+
+// the number of frames described
+int MotionDatabase::RowCount() const
+	{ // RowCount()
+	return firstRow.empty() ? 0 : firstRow.back();
+	} // RowCount()
+
+// a clip's index in the database
+int MotionDatabase::ClipIndex(const BVHData &clip) const
+	{ // ClipIndex()
+	std::unordered_map<const BVHData *, int>::const_iterator found = clipIndex.find(&clip);
+	return found == clipIndex.end() ? -1 : found->second;
+	} // ClipIndex()
+
+// the clip at an index
+const ClipHandle &MotionDatabase::Clip(int clip) const
+	{ // Clip()
+	return clips[clip];
+	} // Clip()
+
+// the row of a frame of a clip
+int MotionDatabase::Row(int clip, int frame) const
+	{ // Row()
+	return firstRow[clip] + frame;
+	} // Row()
+
+// a query for the frame that carries on from a row along a trajectory
+void MotionDatabase::Query(int row, const float *trajectory, float *query) const
+	{ // Query()
+	std::copy(features.Data() + (size_t) row * stride, features.Data() + (size_t) (row + 1) * stride, query);
+	for (int feature = 0; feature < trajectoryFeatures; feature++)
+		query[feature] = (trajectory[feature] - mean[feature]) * scale[feature];
+	} // Query()
+
+// a match for a row at a cost
+MotionMatch MotionDatabase::Match(int row, float cost) const
+	{ // Match()
+	MotionMatch match;
+	match.row = row;
+	match.clip = row < 0 ? -1 : (int) (std::upper_bound(firstRow.begin(), firstRow.end(), row) - firstRow.begin()) - 1;
+	match.frame = row < 0 ? -1 : row - firstRow[match.clip];
+	match.cost = cost;
+	return match;
+	} // Match()
+
+// the nearest frame to a query, skipping branches of the tree whose bounds are no nearer
+MotionMatch MotionDatabase::Search(const float *query, int startRow) const
+	{ // Search()
+	int bestRow = startRow;
+	float bestCost = startRow < 0 ? std::numeric_limits<float>::max() : SquaredDistance(query, features.Data() + (size_t) startRow * stride, stride);
+	if (nodes.empty() || RowCount() == 0)
+		return Match(bestRow, bestCost);
+	// the branches still to look at, each with its bound's distance: the nearer child is
+	// always looked at first, and the depth first walk keeps at most one a level waiting
+	int stackNode[maxTreeDepth + 1];
+	float stackDistance[maxTreeDepth + 1];
+	int waiting = 0;
+	stackNode[waiting] = 0;
+	stackDistance[waiting++] = BoxDistance(query, nodeLow.Data(), nodeHigh.Data(), stride);
+	while (waiting > 0)
+		{ // per branch
+		waiting--;
+		const Node &node = nodes[stackNode[waiting]];
+		// a bound equally near may still hold an earlier row at the same cost
+		if (stackDistance[waiting] > bestCost)
+			continue;
+		if (node.children < 0)
+			{ // leaf
+			for (int place = node.first; place < node.first + node.count; place++)
+				{ // per row
+				float cost = SquaredDistance(query, treeFeatures.Data() + (size_t) place * stride, stride);
+				int row = treeRow[place];
+				if (cost < bestCost || (cost == bestCost && bestRow != startRow && row < bestRow))
+					{ // nearer
+					bestCost = cost;
+					bestRow = row;
+					} // nearer
+				} // per row
+			continue;
+			} // leaf
+		int near = node.children, far = node.children + 1;
+		float nearDistance = BoxDistance(query, nodeLow.Data() + (size_t) near * stride, nodeHigh.Data() + (size_t) near * stride, stride);
+		float farDistance = BoxDistance(query, nodeLow.Data() + (size_t) far * stride, nodeHigh.Data() + (size_t) far * stride, stride);
+		if (farDistance < nearDistance)
+			{ // the second is nearer
+			std::swap(near, far);
+			std::swap(nearDistance, farDistance);
+			} // the second is nearer
+		stackNode[waiting] = far;
+		stackDistance[waiting++] = farDistance;
+		stackNode[waiting] = near;
+		stackDistance[waiting++] = nearDistance;
+		} // per branch
+	return Match(bestRow, bestCost);
+	} // Search()
+
+// the nearest frame to a query, by measuring every frame
+MotionMatch MotionDatabase::SearchEveryFrame(const float *query, int startRow) const
+	{ // SearchEveryFrame()
+	int bestRow = startRow;
+	float bestCost = startRow < 0 ? std::numeric_limits<float>::max() : SquaredDistance(query, features.Data() + (size_t) startRow * stride, stride);
+	for (int row = 0; row < RowCount(); row++)
+		{ // per row
+		float cost = SquaredDistance(query, features.Data() + (size_t) row * stride, stride);
+		if (cost < bestCost || (cost == bestCost && bestRow != startRow && row < bestRow))
+			{ // nearer
+			bestCost = cost;
+			bestRow = row;
+			} // nearer
+		} // per row
+	return Match(bestRow, bestCost);
+	} // SearchEveryFrame()
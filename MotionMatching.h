@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	MotionMatching.h
+//	------------------------
+//
+//	A database of features of every frame of a set of
+//	clips, searched for the frame that best carries on
+//	from the one playing towards a desired trajectory.
+//	Each frame is described by where the root will be,
+//	and which way it will face, over the next second,
+//	where the feet are and how fast they and the hips
+//	move; every feature is scaled so that each group
+//	counts the same. The search walks a KD-tree of the
+//	frames, skipping any branch whose bounding box is no
+//	nearer than the best frame so far, and a plain SIMD
+//	scan of every frame gives the same answer for checking.
+//
+///////////////////////////////////////////////////
+
+#ifndef _MOTIONMATCHING_H
+#define _MOTIONMATCHING_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "AlignedBuffer.h"
+#include "BVHData.h"
+#include "Cartesian3.h"
+
+// the best frame a search found, and its squared distance from the query
+struct MotionMatch
+	{ // struct MotionMatch
+	int row;
+	int clip;
+	int frame;
+	float cost;
+	}; // struct MotionMatch
+
+class MotionDatabase
+	{ // class MotionDatabase
+	public:
+	// the root's future place and facing, sampled this many times over the next second
+	static const int trajectoryPoints = 3;
+	// floats of trajectory: a place on the ground and a facing direction at each
+	static const int trajectoryFeatures = trajectoryPoints * 4;
+	// floats per frame: the trajectory, then each foot's place and velocity and the hips'
+	// velocity, padded to a multiple of four
+	static const int featureCount = trajectoryFeatures + 15;
+	static const int stride = (featureCount + 3) & ~3;
+
+	// describe every frame of a set of clips sharing a skeleton layout (held in memory
+	// or mapped), and build the tree that searches them; a clip with no frames or no
+	// positive frame time has no motion to describe, and is left out (ClipIndex gives -1);
+	// a foot the rig has no joint named for ("LeftFoot", "RightFoot") has its features zeroed
+	void Build(const std::vector<ClipHandle> &clips);
+
+	// the number of frames described
+	int RowCount() const;
+
+	// a clip's index in the database (-1 if it is not there), and the clip at an index
+	int ClipIndex(const BVHData &clip) const;
+	const ClipHandle &Clip(int clip) const;
+
+	// the row of a frame of a clip
+	int Row(int clip, int frame) const;
+
+	// the trajectory of moving over the ground at a constant velocity (clip units per
+	// second along the character's own x and forward) while turning at a constant rate
+	// (degrees per second), as the database describes trajectories before scaling
+	static void ConstantTrajectory(const Cartesian3 &velocity, float turnRate, float *trajectory);
+
+	// the average velocity and turn rate a clip's root motion carries the character at,
+	// in the same terms
+	static void ClipMotion(const BVHData &clip, Cartesian3 &velocity, float &turnRate);
+
+	// a query for the frame that carries on from a row along a trajectory: the row's own
+	// pose features with the trajectory in place of its own (16-byte aligned, stride floats)
+	void Query(int row, const float *trajectory, float *query) const;
+
+	// the nearest frame to a query, starting from a row's own cost (usually the frame that
+	// would play next, so that it is kept unless something is nearer); -1 to start from none
+	// (among frames equally near, the earliest row wins)
+	MotionMatch Search(const float *query, int startRow = -1) const;
+
+	// the same, by measuring every frame
+	MotionMatch SearchEveryFrame(const float *query, int startRow = -1) const;
+
+	private:
+	// a node of the tree: a run of rows in tree order, and its two children (one after
+	// the other) unless it is a leaf
+	struct Node
+		{ // struct Node
+		int first;
+		int count;
+		int children;
+		}; // struct Node
+
+	// make a node for a run of rows in tree order, splitting it if it is big enough
+	void Split(int node, int first, int count);
+
+	// a match for a row at a cost
+	MotionMatch Match(int row, float cost) const;
+
+	// the clips, each one's index and each one's first row (with the total at the end)
+	std::vector<ClipHandle> clips;
+	std::unordered_map<const BVHData *, int> clipIndex;
+	std::vector<int> firstRow;
+
+	// each row's scaled features, and the mean and scale that were applied to them
+	AlignedBuffer<float> features;
+	std::vector<float> mean;
+	std::vector<float> scale;
+
+	// the tree: its nodes, each one's bounds, the rows in tree order, and their features
+	// in that order, so that a leaf's rows lie together
+	std::vector<Node> nodes;
+	AlignedBuffer<float> nodeLow;
+	AlignedBuffer<float> nodeHigh;
+	std::vector<int> treeRow;
+	AlignedBuffer<float> treeFeatures;
+	}; // class MotionDatabase
+
+#endif
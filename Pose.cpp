@@ -0,0 +1,308 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Pose.cpp
+//	------------------------
+//
+//	The joint transforms of a skeleton in one pose, kept
+//	in a buffer owned by the caller. EvaluatePose runs the
+//	forward kinematics into it without touching OpenGL, so
+//	one pose can be drawn, stood on the terrain and measured
+//	without being computed again.
+//
+///////////////////////////////////////////////////
+
+#include "Pose.h"
+#include "BVHData.h"
+#include "PoseCache.h"
+
+#include <algorithm>
+#include <math.h>
+
+// rotations closer than this in every component count as unchanged (well below what
+// a bvh file's six decimal places of a degree can tell apart)
+static const float unchangedRotation = 1.0e-6f;
+
+// add another pose's counts to these
+PoseCounters &PoseCounters::operator +=(const PoseCounters &other)
+	{ // operator +=()
+	posesEvaluated += other.posesEvaluated;
+	posesCached += other.posesCached;
+	posesSkipped += other.posesSkipped;
+	jointsEvaluated += other.jointsEvaluated;
+	jointsSkipped += other.jointsSkipped;
+	return *this;
+	} // operator +=()
+
+// whether a joint's rotation has changed since the pose was evaluated
+static inline bool RotationChanged(const Quaternion &previous, const Quaternion &next)
+	{ // RotationChanged()
+	return fabsf(previous.x - next.x) > unchangedRotation || fabsf(previous.y - next.y) > unchangedRotation
+		|| fabsf(previous.z - next.z) > unchangedRotation || fabsf(previous.w - next.w) > unchangedRotation;
+	} // RotationChanged()
+
+// forget what the pose was evaluated from
+void Pose::Forget()
+	{ // Forget()
+	skeleton = nullptr;
+	sourceClip = nullptr;
+	sourceFrame = -1;
+	sourceSerial = 0;
+	} // Forget()
+
+// number of joints in the pose
+int Pose::JointCount() const
+	{ // JointCount()
+	return (int) model.size();
+	} // JointCount()
+
+// position of a joint in model space
+Cartesian3 Pose::Position(int joint) const
+	{ // Position()
+	return model[joint].column(3).Vector();
+	} // Position()
+
+// position of a joint in the clip's own space
+Cartesian3 Pose::ClipPosition(int joint) const
+	{ // ClipPosition()
+	return Position(joint) + rootPosition;
+	} // ClipPosition()
+
+// the frame of a clip showing at a time in seconds from its start
+int FrameAt(const BVHData &clip, float time)
+	{ // FrameAt()
+	// a time that lands on a frame (up to rounding) gives that frame
+	return clip.frame_time > 0.0f ? (int) floorf(time / clip.frame_time + 1.0e-3f) : 0;
+	} // FrameAt()
+
+// fill a pose with a clip at a time in seconds from its start
+void EvaluatePose(const BVHData &clip, float time, Pose &pose)
+	{ // EvaluatePose()
+	EvaluateFrame(clip, FrameAt(clip, time), pose);
+	} // EvaluatePose()
+
+// the frame a time falls on or after and the fraction of the way to the next, wrapped
+// round a looping clip and clamped to any other; t is 0 within rounding of a frame
+static int SamplePosition(const BVHData &clip, float seconds, bool loop, int &next, float &t)
+	{ // SamplePosition()
+	next = 0;
+	t = 0.0f;
+	if (clip.frame_count <= 1 || clip.frame_time <= 0.0f)
+		return 0;
+	float position = seconds / clip.frame_time;
+	if (loop)
+		{ // wrap
+		position = fmodf(position, (float) clip.frame_count);
+		if (position < 0.0f)
+			position += clip.frame_count;
+		} // wrap
+	else
+		position = std::min(std::max(position, 0.0f), (float) (clip.frame_count - 1));
+	int frame = (int) floorf(position + 1.0e-3f);
+	t = position - frame;
+	if (frame >= clip.frame_count)
+		frame = loop ? 0 : clip.frame_count - 1;
+	if (t < 1.0e-3f)
+		t = 0.0f;
+	next = frame + 1 < clip.frame_count ? frame + 1 : (loop ? 0 : frame);
+	return frame;
+	} // SamplePosition()
+
+// a clip's rotations and root position at a time, interpolated between frames
+void SampleRotations(const BVHData &clip, float seconds, bool loop, Quaternion *rotations, Cartesian3 &rootPosition)
+	{ // SampleRotations()
+	int next;
+	float t;
+	int frame = SamplePosition(clip, seconds, loop, next, t);
+	int jointCount = clip.skeleton.JointCount();
+	// copy the root positions first, one at a time: for a streamed or compressed clip
+	// they live in the buffer the frame is decoded into
+	rootPosition = clip.RootPosition(frame);
+	if (t == 0.0f)
+		{ // on a frame
+		const Quaternion *frameRotations = clip.FrameQuaternions(frame);
+		std::copy(frameRotations, frameRotations + jointCount, rotations);
+		return;
+		} // on a frame
+	rootPosition = rootPosition * (1.0f - t);
+	rootPosition = rootPosition + clip.RootPosition(next) * t;
+	// and the first frame's rotations are copied out of that buffer before the second is decoded
+	const Skeleton &skeleton = clip.skeleton;
+	const Quaternion *from = clip.FrameQuaternions(frame);
+	if (clip.quaternionTrack == nullptr)
+		{ // decoded
+		thread_local std::vector<Quaternion> fromCopy;
+		fromCopy.assign(from, from + jointCount);
+		from = fromCopy.data();
+		} // decoded
+	skeleton.kernels->blendRotations(skeleton, from, clip.FrameQuaternions(next), t, rotations);
+	} // SampleRotations()
+
+// fill a pose with a clip at a time, interpolated between frames
+void Sample(const BVHData &clip, float seconds, Pose &pose, bool loop)
+	{ // Sample()
+	int next;
+	float t;
+	int frame = SamplePosition(clip, seconds, loop, next, t);
+	// a time within rounding of a frame shows that frame, straight from the pose cache
+	if (t == 0.0f)
+		{ // on a frame
+		EvaluateFrame(clip, frame, pose);
+		return;
+		} // on a frame
+	// the blend goes through EvaluatePose, so that joints the two frames agree on are skipped
+	thread_local std::vector<Quaternion> blended;
+	blended.resize(clip.skeleton.JointCount());
+	Cartesian3 rootPosition;
+	SampleRotations(clip, seconds, loop, blended.data(), rootPosition);
+	EvaluatePose(clip, blended.data(), rootPosition, pose);
+	} // Sample()
+
+// fill a pose with one of a clip's frames
+void EvaluateFrame(const BVHData &clip, int frame, Pose &pose)
+	{ // EvaluateFrame()
+	if (frame >= clip.frame_count)
+		frame = clip.frame_count - 1;
+	if (frame < 0)
+		frame = 0;
+	// the frame the pose already shows (e.g. a character standing in a one-frame clip) needs nothing doing
+	if (pose.sourceClip == &clip && pose.sourceSerial == clip.serial && pose.sourceFrame == frame)
+		{ // unchanged
+		pose.counters.posesSkipped++;
+		pose.counters.jointsSkipped += pose.JointCount();
+		return;
+		} // unchanged
+	// copy the root position first: for a streamed clip it shares the rotations' page
+	Cartesian3 rootPosition = clip.RootPosition(frame);
+	// a frame that has been evaluated before is copied from the clip's cache
+	const PoseCache *cache = clip.poseCache.get();
+	if (cache != nullptr && cache->Fetch(frame, pose))
+		{ // cached
+		pose.rootPosition = rootPosition;
+		pose.skeleton = nullptr;
+		pose.sourceClip = &clip;
+		pose.sourceFrame = frame;
+		pose.sourceSerial = clip.serial;
+		pose.counters.posesCached++;
+		return;
+		} // cached
+	EvaluatePose(clip, clip.FrameQuaternions(frame), rootPosition, pose);
+	pose.sourceClip = &clip;
+	pose.sourceFrame = frame;
+	pose.sourceSerial = clip.serial;
+	if (cache != nullptr)
+		cache->Store(frame, pose);
+	} // EvaluateFrame()
+
+// fill only a chain's joints of a pose from one of a clip's frames
+void EvaluateChain(const BVHData &clip, int frame, const JointChain &chain, Pose &pose)
+	{ // EvaluateChain()
+	frame = std::min(std::max(frame, 0), clip.frame_count - 1);
+	// the whole frame is already there
+	if (pose.sourceClip == &clip && pose.sourceSerial == clip.serial && pose.sourceFrame == frame)
+		{ // unchanged
+		pose.counters.posesSkipped++;
+		pose.counters.jointsSkipped += pose.JointCount();
+		return;
+		} // unchanged
+	const Skeleton &skeleton = clip.skeleton;
+	int jointCount = skeleton.JointCount();
+	pose.model.resize(jointCount);
+	pose.rootPosition = clip.RootPosition(frame);
+	pose.skeleton = nullptr;
+	pose.sourceClip = nullptr;
+	pose.sourceFrame = -1;
+	pose.sourceSerial = 0;
+	int chainCount = (int) chain.joints.size();
+	pose.counters.jointsSkipped += jointCount - chainCount;
+	const PoseCache *cache = clip.poseCache.get();
+	if (cache != nullptr && cache->FetchChain(frame, chain, pose))
+		{ // cached
+		pose.counters.posesCached++;
+		return;
+		} // cached
+	// the chain holds every ancestor of its joints, in order, so each parent is ready in time
+	const Quaternion *rotations = clip.FrameQuaternions(frame);
+	for (int joint : chain.joints)
+		{ // per joint
+		int parent = skeleton.parent[joint];
+		JointTransform(parent < 0 ? nullptr : &pose.model[parent], rotations[joint], skeleton.offset[joint], pose.model[joint]);
+		} // per joint
+	pose.counters.posesEvaluated++;
+	pose.counters.jointsEvaluated += chainCount;
+	} // EvaluateChain()
+
+// fill a pose with rotations that are not one of the clip's frames
+// parents come before children, so one pass from the root computes every joint
+void EvaluatePose(const BVHData &clip, const Quaternion *rotations, const Cartesian3 &rootPosition, Pose &pose)
+	{ // EvaluatePose()
+	const Skeleton &skeleton = clip.skeleton;
+	int jointCount = skeleton.JointCount();
+	pose.rootPosition = rootPosition;
+	pose.sourceClip = nullptr;
+	pose.sourceFrame = -1;
+
+	// a pose last evaluated from known rotations on this skeleton keeps the transforms of
+	// joints where neither the joint's rotation nor any above it has changed
+	if (pose.skeleton == &skeleton && pose.sourceSerial == clip.serial && pose.JointCount() == jointCount)
+		{ // incremental
+		thread_local std::vector<unsigned char> dirty;
+		dirty.resize(jointCount);
+		int dirtyCount = 0;
+		for (int joint = 0; joint < jointCount; joint++)
+			{ // per joint
+			int parent = skeleton.parent[joint];
+			bool changed = RotationChanged(pose.rotations[joint], rotations[joint]);
+			if (changed)
+				pose.rotations[joint] = rotations[joint];
+			dirty[joint] = changed || (parent >= 0 && dirty[parent]);
+			dirtyCount += dirty[joint];
+			} // per joint
+		if (dirtyCount == 0)
+			{ // unchanged
+			pose.counters.posesSkipped++;
+			pose.counters.jointsSkipped += jointCount;
+			return;
+			} // unchanged
+		// when every joint moved, the whole-skeleton kernel below is faster than picking them out
+		if (dirtyCount < jointCount)
+			{ // some changed
+			for (int joint = 0; joint < jointCount; joint++)
+				if (dirty[joint])
+					{ // dirty joint
+					int parent = skeleton.parent[joint];
+					JointTransform(parent < 0 ? nullptr : &pose.model[parent], pose.rotations[joint], skeleton.offset[joint], pose.model[joint]);
+					} // dirty joint
+			pose.counters.posesEvaluated++;
+			pose.counters.jointsEvaluated += dirtyCount;
+			pose.counters.jointsSkipped += jointCount - dirtyCount;
+			return;
+			} // some changed
+		} // incremental
+
+	// the buffers only grow, so a pose that is reused does not allocate
+	pose.model.resize(jointCount);
+	pose.rotations.assign(rotations, rotations + jointCount);
+	pose.skeleton = &skeleton;
+	pose.sourceSerial = clip.serial;
+	// through the kernel the skeleton picked for its joint count (see PoseKernels.h)
+	skeleton.kernels->forwardKinematics(skeleton, rotations, pose.model.data());
+	pose.counters.posesEvaluated++;
+	pose.counters.jointsEvaluated += jointCount;
+	} // EvaluatePose()
+
+// fill a pose with two sets of rotations blended
+void EvaluateBlend(const BVHData &clip, const Quaternion *from, const Quaternion *to, float t, const Cartesian3 &rootPosition, Pose &pose)
+	{ // EvaluateBlend()
+	const Skeleton &skeleton = clip.skeleton;
+	pose.model.resize(skeleton.JointCount());
+	pose.rootPosition = rootPosition;
+	// the blended rotations stay on the stack, so the next evaluation starts afresh
+	pose.skeleton = nullptr;
+	pose.sourceClip = nullptr;
+	pose.sourceFrame = -1;
+	pose.sourceSerial = 0;
+	skeleton.kernels->blendPose(skeleton, from, to, t, pose.model.data());
+	pose.counters.posesEvaluated++;
+	pose.counters.jointsEvaluated += skeleton.JointCount();
+	} // EvaluateBlend()
@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Pose.h
+//	------------------------
+//
+//	The joint transforms of a skeleton in one pose, kept
+//	in a buffer owned by the caller. EvaluatePose runs the
+//	forward kinematics into it without touching OpenGL, so
+//	one pose can be drawn, stood on the terrain and measured
+//	without being computed again. A pose also remembers
+//	what it was evaluated from, so that evaluating it
+//	again only recomputes the joints whose rotations (or
+//	whose ancestors' rotations) have changed, and skips a
+//	clip frame it already shows altogether.
+//
+///////////////////////////////////////////////////
+
+#ifndef _POSE_H
+#define _POSE_H
+
+#include <vector>
+
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+
+class BVHData;
+class JointChain;
+class Skeleton;
+
+// the work evaluating a pose has done and skipped, kept per pose so that threads
+// evaluating different poses never share a counter
+struct PoseCounters
+	{ // struct PoseCounters
+	// evaluations that ran forward kinematics on at least one joint, that copied the
+	// pose from the clip's pose cache, and that found the pose already up to date
+	long posesEvaluated = 0;
+	long posesCached = 0;
+	long posesSkipped = 0;
+
+	// joints recomputed, and joints left as they were because neither they nor any
+	// joint above them changed (every joint of a skipped pose counts as skipped)
+	long jointsEvaluated = 0;
+	long jointsSkipped = 0;
+
+	// add another pose's counts to these
+	PoseCounters &operator +=(const PoseCounters &other);
+	}; // struct PoseCounters
+
+class Pose
+	{ // class Pose
+	public:
+	// each joint's transform in model space, with the root at its offset (as the
+	// skeleton is drawn)
+	std::vector<Matrix4> model;
+
+	// the root's position channels; the model transforms leave these out, since the
+	// character is moved over the ground by its root motion instead
+	Cartesian3 rootPosition;
+
+	// what the model transforms were last evaluated from: the skeleton and each joint's
+	// rotation (skeleton is nullptr when the rotations are not known, e.g. after a blend
+	// or a copy from the pose cache), and the clip frame if it was one of a clip's frames
+	// (sourceClip is nullptr otherwise); both count only while sourceSerial is still the
+	// serial of the clip they came from (see BVHData::serial), since a clip destroyed and
+	// another made at its address would otherwise look like the same clip
+	const Skeleton *skeleton = nullptr;
+	std::vector<Quaternion> rotations;
+	const BVHData *sourceClip = nullptr;
+	int sourceFrame = -1;
+	unsigned long long sourceSerial = 0;
+
+	// the work done and skipped filling this pose
+	PoseCounters counters;
+
+	// forget what the pose was evaluated from, so that the next evaluation runs in full
+	// (for timing it, or after writing the model transforms directly)
+	void Forget();
+
+	// number of joints in the pose
+	int JointCount() const;
+
+	// position of a joint in model space
+	Cartesian3 Position(int joint) const;
+
+	// position of a joint in the clip's own space, with the root position applied
+	Cartesian3 ClipPosition(int joint) const;
+	}; // class Pose
+
+// the frame of a clip showing at a time in seconds from its start (not clamped)
+int FrameAt(const BVHData &clip, float time);
+
+// fill a pose with a clip at a time in seconds from its start (clamped to the clip)
+void EvaluatePose(const BVHData &clip, float time, Pose &pose);
+
+// fill a pose with a clip at a time in seconds from its start, interpolated between the
+// two frames either side of it by the clip's own frame time; a looping clip wraps the
+// time round and interpolates from its last frame into its first, any other clip is
+// clamped to its ends
+void Sample(const BVHData &clip, float seconds, Pose &pose, bool loop = false);
+
+// the rotations and root position Sample would pose a clip with, written to a buffer of
+// one rotation per joint (e.g. an input to a blend)
+void SampleRotations(const BVHData &clip, float seconds, bool loop, Quaternion *rotations, Cartesian3 &rootPosition);
+
+// fill a pose with one of a clip's frames
+void EvaluateFrame(const BVHData &clip, int frame, Pose &pose);
+
+// fill only a chain's joints of a pose (see JointChain in Skeleton.h) from one of a clip's
+// frames, so that a query about a few joints costs a few matrix products rather than
+// the whole skeleton; the other joints' transforms are left as they were, and the pose
+// counts as unknown to the incremental evaluation
+void EvaluateChain(const BVHData &clip, int frame, const JointChain &chain, Pose &pose);
+
+// fill a pose with rotations that are not one of the clip's frames (e.g. a blend); if
+// the pose was last evaluated from rotations on the same skeleton, only the joints below
+// a changed rotation are recomputed
+void EvaluatePose(const BVHData &clip, const Quaternion *rotations, const Cartesian3 &rootPosition, Pose &pose);
+
+// fill a pose with two sets of rotations blended a fraction t of the way from one to the
+// other, without storing the blend anywhere but the stack
+void EvaluateBlend(const BVHData &clip, const Quaternion *from, const Quaternion *to, float t, const Cartesian3 &rootPosition, Pose &pose);
+
+#endif
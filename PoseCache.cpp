@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PoseCache.cpp
+//	------------------------
+//
+//	Model-space joint transforms of a clip's frames, kept
+//	so that a looping clip only runs its forward kinematics
+//	once per frame rather than once per frame per loop.
+//	Frames are either baked up front or stored on their
+//	first visit, up to a fixed number of bytes.
+//
+///////////////////////////////////////////////////
+
+#include "PoseCache.h"
+#include "BVHData.h"
+#include "Pose.h"
+
+#include <algorithm>
+#include <cstring>
+
+// the states a frame moves through
+enum { frameEmpty = 0, frameStoring = 1, frameStored = 2 };
+
+// room for as many of a clip's frames as fit in maxBytes
+PoseCache::PoseCache(const BVHData &clip, size_t maxBytes)
+	: jointCount(clip.skeleton.JointCount()),
+	frameCount(0),
+	hits(0),
+	misses(0)
+	{ // constructor
+	size_t frameBytes = std::max<size_t>(1, jointCount * sizeof(Matrix4));
+	frameCount = (int) std::min<size_t>(clip.frame_count, maxBytes / frameBytes);
+	models.Resize((size_t) frameCount * jointCount);
+	state.reset(new std::atomic<unsigned char>[frameCount]);
+	for (int frame = 0; frame < frameCount; frame++)
+		state[frame].store(frameEmpty, std::memory_order_relaxed);
+	} // constructor
+
+// evaluate and store every frame that fits
+void PoseCache::Bake(const BVHData &clip)
+	{ // Bake()
+	Pose pose;
+	for (int frame = 0; frame < frameCount; frame++)
+		{ // per frame
+		EvaluatePose(clip, clip.FrameQuaternions(frame), clip.RootPosition(frame), pose);
+		Store(frame, pose);
+		} // per frame
+	} // Bake()
+
+// copy a stored frame's model transforms into a pose
+bool PoseCache::Fetch(int frame, Pose &pose) const
+	{ // Fetch()
+	if (frame < 0 || frame >= frameCount || state[frame].load(std::memory_order_acquire) != frameStored)
+		{ // not stored
+		misses.fetch_add(1, std::memory_order_relaxed);
+		return false;
+		} // not stored
+	pose.model.resize(jointCount);
+	memcpy((void *) pose.model.data(), &models[(size_t) frame * jointCount], jointCount * sizeof(Matrix4));
+	hits.fetch_add(1, std::memory_order_relaxed);
+	return true;
+	} // Fetch()
+
+// copy only a chain's joints of a stored frame into a pose
+bool PoseCache::FetchChain(int frame, const JointChain &chain, Pose &pose) const
+	{ // FetchChain()
+	if (frame < 0 || frame >= frameCount || state[frame].load(std::memory_order_acquire) != frameStored)
+		{ // not stored
+		misses.fetch_add(1, std::memory_order_relaxed);
+		return false;
+		} // not stored
+	const Matrix4 *stored = &models[(size_t) frame * jointCount];
+	for (int joint : chain.joints)
+		pose.model[joint] = stored[joint];
+	hits.fetch_add(1, std::memory_order_relaxed);
+	return true;
+	} // FetchChain()
+
+// store a frame the pose has just been evaluated for
+void PoseCache::Store(int frame, const Pose &pose) const
+	{ // Store()
+	if (frame < 0 || frame >= frameCount || pose.JointCount() != jointCount)
+		return;
+	// only the thread that claims an empty frame writes it
+	unsigned char expected = frameEmpty;
+	if (!state[frame].compare_exchange_strong(expected, frameStoring, std::memory_order_acquire))
+		return;
+	memcpy((void *) &models[(size_t) frame * jointCount], pose.model.data(), jointCount * sizeof(Matrix4));
+	state[frame].store(frameStored, std::memory_order_release);
+	} // Store()
+
+// number of frames there is room for
+int PoseCache::CachedFrames() const
+	{ // CachedFrames()
+	return frameCount;
+	} // CachedFrames()
+
+// bytes held
+size_t PoseCache::Bytes() const
+	{ // Bytes()
+	return models.Size() * sizeof(Matrix4) + frameCount * sizeof(std::atomic<unsigned char>);
+	} // Bytes()
+
+// lookups that found their frame
+long PoseCache::Hits() const
+	{ // Hits()
+	return hits.load(std::memory_order_relaxed);
+	} // Hits()
+
+// lookups that did not
+long PoseCache::Misses() const
+	{ // Misses()
+	return misses.load(std::memory_order_relaxed);
+	} // Misses()
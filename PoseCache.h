@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PoseCache.h
+//	------------------------
+//
+//	Model-space joint transforms of a clip's frames, kept
+//	so that a looping clip only runs its forward kinematics
+//	once per frame rather than once per frame per loop.
+//	Frames are either baked up front or stored on their
+//	first visit, up to a fixed number of bytes.
+//
+///////////////////////////////////////////////////
+
+#ifndef _POSECACHE_H
+#define _POSECACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "AlignedBuffer.h"
+#include "Matrix4.h"
+
+class BVHData;
+class JointChain;
+class Pose;
+
+class PoseCache
+	{ // class PoseCache
+	public:
+	// room for as many of a clip's frames as fit in maxBytes, counting from frame 0
+	PoseCache(const BVHData &clip, size_t maxBytes);
+
+	// evaluate and store every frame that fits
+	void Bake(const BVHData &clip);
+
+	// copy a stored frame's model transforms into a pose; false if it is not stored
+	bool Fetch(int frame, Pose &pose) const;
+
+	// copy only a chain's joints of a stored frame into a pose (sized for the skeleton)
+	bool FetchChain(int frame, const JointChain &chain, Pose &pose) const;
+
+	// store a frame the pose has just been evaluated for, if there is room for it and
+	// no other thread has stored it already
+	void Store(int frame, const Pose &pose) const;
+
+	// number of frames there is room for, and bytes held
+	int CachedFrames() const;
+	size_t Bytes() const;
+
+	// lookups that found their frame and that did not, since the cache was made
+	long Hits() const;
+	long Misses() const;
+
+	private:
+	// joints per frame, and the frames there is room for
+	int jointCount;
+	int frameCount;
+
+	// the model transforms, frame-major with one per joint
+	// (filled through a const cache, like the clip's other on-demand data)
+	mutable AlignedBuffer<Matrix4> models;
+
+	// the state of each frame: empty, being stored by one thread, or stored
+	// a frame is only read once it is marked stored, so threads may share a cache
+	std::unique_ptr<std::atomic<unsigned char>[]> state;
+
+	// statistics
+	mutable std::atomic<long> hits;
+	mutable std::atomic<long> misses;
+	}; // class PoseCache
+
+#endif
@@ -0,0 +1,412 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PoseKernels.cpp
+//	------------------------
+//
+//	The inner loops of posing a skeleton: forward
+//	kinematics, blending two sets of rotations, and
+//	converting Euler angles to quaternions. Each comes as
+//	a generic loop and as versions compiled for a fixed
+//	joint count or rotation order, with fixed-length loops
+//	and scratch space on the stack; a skeleton picks the
+//	matching versions as it is built.
+//
+///////////////////////////////////////////////////
+
+#include "PoseKernels.h"
+#include "Skeleton.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+// the same choice of instruction set as Matrix4.cpp
+#if !defined(MATRIX4_NO_SIMD)
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define POSEKERNELS_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define POSEKERNELS_NEON
+#endif
+#endif
+
+// the kernels load each quaternion as one register
+static_assert(sizeof(Quaternion) == 4 * sizeof(float) && alignof(Quaternion) >= 16, "Quaternion must be four aligned floats");
+
+#if defined(POSEKERNELS_SSE)
+// the sum of the four lanes, in every lane
+static inline __m128 SumLanes(__m128 value)
+	{ // SumLanes()
+	value = _mm_add_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_add_ps(value, _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 0, 3, 2)));
+	} // SumLanes()
+#elif defined(POSEKERNELS_NEON)
+// the sum of the four lanes
+static inline float SumLanes(float32x4_t value)
+	{ // SumLanes()
+	float32x2_t pair = vpadd_f32(vget_low_f32(value), vget_high_f32(value));
+	return vget_lane_f32(pair, 0) + vget_lane_f32(pair, 1);
+	} // SumLanes()
+#endif
+
+// one joint's transform relative to its parent: its offset, then its rotation
+// (Quaternion::GetMatrix, written out here so that the kernels can inline it)
+static inline void LocalMatrix(const Quaternion &q, const Cartesian3 &offset, Matrix4 &local)
+	{ // LocalMatrix()
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	local.coordinates[0][0] = 1.0f - 2.0f * (yy + zz);
+	local.coordinates[0][1] = 2.0f * (xy - wz);
+	local.coordinates[0][2] = 2.0f * (xz + wy);
+	local.coordinates[0][3] = offset.x;
+	local.coordinates[1][0] = 2.0f * (xy + wz);
+	local.coordinates[1][1] = 1.0f - 2.0f * (xx + zz);
+	local.coordinates[1][2] = 2.0f * (yz - wx);
+	local.coordinates[1][3] = offset.y;
+	local.coordinates[2][0] = 2.0f * (xz - wy);
+	local.coordinates[2][1] = 2.0f * (yz + wx);
+	local.coordinates[2][2] = 1.0f - 2.0f * (xx + yy);
+	local.coordinates[2][3] = offset.z;
+	local.coordinates[3][0] = local.coordinates[3][1] = local.coordinates[3][2] = 0.0f;
+	local.coordinates[3][3] = 1.0f;
+	} // LocalMatrix()
+
+// one joint's model transform from its parent's, when both are rigid (their last row is
+// 0 0 0 1, as every transform built by LocalMatrix is): only the top three rows of the
+// product are worked out, and the joint's local transform is never stored
+static inline void AffineJoint(const Matrix4 &parent, const Quaternion &q, const Cartesian3 &offset, Matrix4 &model)
+	{ // AffineJoint()
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+#if defined(POSEKERNELS_SSE)
+	// the rows of the local transform, each with its offset in the last lane
+	__m128 local0 = _mm_setr_ps(1.0f - 2.0f * (yy + zz), 2.0f * (xy - wz), 2.0f * (xz + wy), offset.x);
+	__m128 local1 = _mm_setr_ps(2.0f * (xy + wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz - wx), offset.y);
+	__m128 local2 = _mm_setr_ps(2.0f * (xz - wy), 2.0f * (yz + wx), 1.0f - 2.0f * (xx + yy), offset.z);
+	for (int row = 0; row < 3; row++)
+		{ // per row
+		__m128 parentRow = _mm_load_ps(parent.coordinates[row]);
+		// the parent's translation only reaches the last lane, through the local 0 0 0 1
+		__m128 product = _mm_and_ps(parentRow, _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1)));
+		product = _mm_add_ps(product, _mm_mul_ps(_mm_shuffle_ps(parentRow, parentRow, 0x00), local0));
+		product = _mm_add_ps(product, _mm_mul_ps(_mm_shuffle_ps(parentRow, parentRow, 0x55), local1));
+		product = _mm_add_ps(product, _mm_mul_ps(_mm_shuffle_ps(parentRow, parentRow, 0xAA), local2));
+		_mm_store_ps(model.coordinates[row], product);
+		} // per row
+#else
+	float local00 = 1.0f - 2.0f * (yy + zz), local01 = 2.0f * (xy - wz), local02 = 2.0f * (xz + wy);
+	float local10 = 2.0f * (xy + wz), local11 = 1.0f - 2.0f * (xx + zz), local12 = 2.0f * (yz - wx);
+	float local20 = 2.0f * (xz - wy), local21 = 2.0f * (yz + wx), local22 = 1.0f - 2.0f * (xx + yy);
+	for (int row = 0; row < 3; row++)
+		{ // per row
+		float p0 = parent.coordinates[row][0], p1 = parent.coordinates[row][1], p2 = parent.coordinates[row][2];
+		model.coordinates[row][0] = p0 * local00 + p1 * local10 + p2 * local20;
+		model.coordinates[row][1] = p0 * local01 + p1 * local11 + p2 * local21;
+		model.coordinates[row][2] = p0 * local02 + p1 * local12 + p2 * local22;
+		model.coordinates[row][3] = p0 * offset.x + p1 * offset.y + p2 * offset.z + parent.coordinates[row][3];
+		} // per row
+#endif
+	model.coordinates[3][0] = model.coordinates[3][1] = model.coordinates[3][2] = 0.0f;
+	model.coordinates[3][3] = 1.0f;
+	} // AffineJoint()
+
+// one joint's model transform; parents come before children
+static inline void ForwardJoint(int joint, const int *parent, const Cartesian3 *offset, const Quaternion *rotations, Matrix4 *model)
+	{ // ForwardJoint()
+	if (parent[joint] < 0)
+		LocalMatrix(rotations[joint], offset[joint], model[joint]);
+	else
+		AffineJoint(model[parent[joint]], rotations[joint], offset[joint], model[joint]);
+	} // ForwardJoint()
+
+// one joint's model transform from its parent's (nullptr for a root)
+void JointTransform(const Matrix4 *parent, const Quaternion &rotation, const Cartesian3 &offset, Matrix4 &model)
+	{ // JointTransform()
+	if (parent == nullptr)
+		LocalMatrix(rotation, offset, model);
+	else
+		AffineJoint(*parent, rotation, offset, model);
+	} // JointTransform()
+
+// nlerp along the shorter arc (Quaternion::Nlerp, inlined)
+static inline Quaternion BlendJoint(const Quaternion &from, const Quaternion &to, float t)
+	{ // BlendJoint()
+	float toWeight = from.x * to.x + from.y * to.y + from.z * to.z + from.w * to.w < 0.0f ? -t : t;
+	float fromWeight = 1.0f - t;
+	Quaternion blended(from.x * fromWeight + to.x * toWeight, from.y * fromWeight + to.y * toWeight,
+		from.z * fromWeight + to.z * toWeight, from.w * fromWeight + to.w * toWeight);
+	float lengthSquared = blended.x * blended.x + blended.y * blended.y + blended.z * blended.z + blended.w * blended.w;
+	if (lengthSquared <= 0.0f)
+		return Quaternion();
+	return blended * (1.0f / sqrtf(lengthSquared));
+	} // BlendJoint()
+
+// generic forward kinematics: a loop over however many joints there are
+static void GenericForwardKinematics(const Skeleton &skeleton, const Quaternion *rotations, Matrix4 *model)
+	{ // GenericForwardKinematics()
+	int jointCount = skeleton.JointCount();
+	for (int joint = 0; joint < jointCount; joint++)
+		ForwardJoint(joint, skeleton.parent.data(), skeleton.offset.data(), rotations, model);
+	} // GenericForwardKinematics()
+
+// generic blend
+static void GenericBlendRotations(const Skeleton &skeleton, const Quaternion *from, const Quaternion *to, float t, Quaternion *blended)
+	{ // GenericBlendRotations()
+	int jointCount = skeleton.JointCount();
+	for (int joint = 0; joint < jointCount; joint++)
+		blended[joint] = BlendJoint(from[joint], to[joint], t);
+	} // GenericBlendRotations()
+
+// generic blended pose, with the blended rotations in a buffer kept per thread
+static void GenericBlendPose(const Skeleton &skeleton, const Quaternion *from, const Quaternion *to, float t, Matrix4 *model)
+	{ // GenericBlendPose()
+	thread_local std::vector<Quaternion> blended;
+	blended.resize(skeleton.JointCount());
+	GenericBlendRotations(skeleton, from, to, t, blended.data());
+	GenericForwardKinematics(skeleton, blended.data(), model);
+	} // GenericBlendPose()
+
+// forward kinematics for a fixed joint count, with the only root at joint 0, so that
+// every joint after it has a parent to multiply by and the loop has no branch
+template <int JointCount>
+static void FixedForwardKinematics(const Skeleton &skeleton, const Quaternion *rotations, Matrix4 *model)
+	{ // FixedForwardKinematics()
+	const int *parent = skeleton.parent.data();
+	const Cartesian3 *offset = skeleton.offset.data();
+	LocalMatrix(rotations[0], offset[0], model[0]);
+	for (int joint = 1; joint < JointCount; joint++)
+		AffineJoint(model[parent[joint]], rotations[joint], offset[joint], model[joint]);
+	} // FixedForwardKinematics()
+
+// blend for a fixed joint count
+template <int JointCount>
+static void FixedBlendRotations(const Skeleton &, const Quaternion *from, const Quaternion *to, float t, Quaternion *blended)
+	{ // FixedBlendRotations()
+	for (int joint = 0; joint < JointCount; joint++)
+		blended[joint] = BlendJoint(from[joint], to[joint], t);
+	} // FixedBlendRotations()
+
+// blended pose for a fixed joint count, with the blended rotations on the stack
+template <int JointCount>
+static void FixedBlendPose(const Skeleton &skeleton, const Quaternion *from, const Quaternion *to, float t, Matrix4 *model)
+	{ // FixedBlendPose()
+	Quaternion blended[JointCount];
+	FixedBlendRotations<JointCount>(skeleton, from, to, t, blended);
+	FixedForwardKinematics<JointCount>(skeleton, blended, model);
+	} // FixedBlendPose()
+
+// the kernels for one fixed joint count
+template <int JointCount>
+static PoseKernels FixedPoseKernels(const char *name)
+	{ // FixedPoseKernels()
+	return PoseKernels { JointCount, name, FixedForwardKinematics<JointCount>, FixedBlendRotations<JointCount>, FixedBlendPose<JointCount> };
+	} // FixedPoseKernels()
+
+// the generic kernels
+static const PoseKernels genericKernels = { 0, "generic", GenericForwardKinematics, GenericBlendRotations, GenericBlendPose };
+
+// the joint counts with kernels of their own: the 65-joint rig every shipped clip uses
+static const PoseKernels fixedKernels[] =
+	{ // fixedKernels
+	FixedPoseKernels<65>("65 joints")
+	}; // fixedKernels
+
+// the kernels compiled for a joint count, or the generic ones if there are none
+const PoseKernels &PoseKernelsFor(int jointCount, int rootCount)
+	{ // PoseKernelsFor()
+	if (rootCount != 1)
+		return genericKernels;
+	for (const PoseKernels &kernels : fixedKernels)
+		if (kernels.jointCount == jointCount)
+			return kernels;
+	return genericKernels;
+	} // PoseKernelsFor()
+
+// the generic kernels
+const PoseKernels &GenericPoseKernels()
+	{ // GenericPoseKernels()
+	return genericKernels;
+	} // GenericPoseKernels()
+
+// add weighted rotations to a running sum, each on the reference's side
+void AccumulateRotations(const Quaternion *reference, const Quaternion *rotations, float weight, Quaternion *sum, int count)
+	{ // AccumulateRotations()
+#if defined(POSEKERNELS_SSE)
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	const __m128 weights = _mm_set1_ps(weight);
+	for (int joint = 0; joint < count; joint++)
+		{ // per joint
+		__m128 rotation = _mm_load_ps(&rotations[joint].x);
+		// the sign of the dot product, flipped into every lane of the rotation
+		__m128 sign = _mm_and_ps(SumLanes(_mm_mul_ps(rotation, _mm_load_ps(&reference[joint].x))), signBit);
+		rotation = _mm_xor_ps(rotation, sign);
+		_mm_store_ps(&sum[joint].x, _mm_add_ps(_mm_load_ps(&sum[joint].x), _mm_mul_ps(rotation, weights)));
+		} // per joint
+#elif defined(POSEKERNELS_NEON)
+	for (int joint = 0; joint < count; joint++)
+		{ // per joint
+		float32x4_t rotation = vld1q_f32(&rotations[joint].x);
+		float side = SumLanes(vmulq_f32(rotation, vld1q_f32(&reference[joint].x))) < 0.0f ? -weight : weight;
+		vst1q_f32(&sum[joint].x, vmlaq_n_f32(vld1q_f32(&sum[joint].x), rotation, side));
+		} // per joint
+#else
+	for (int joint = 0; joint < count; joint++)
+		{ // per joint
+		const Quaternion &rotation = rotations[joint];
+		float side = rotation.dot(reference[joint]) < 0.0f ? -weight : weight;
+		sum[joint] = sum[joint] + rotation * side;
+		} // per joint
+#endif
+	} // AccumulateRotations()
+
+// scale rotations to unit length
+void NormalizeRotations(Quaternion *rotations, int count)
+	{ // NormalizeRotations()
+#if defined(POSEKERNELS_SSE)
+	const __m128 identity = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+	for (int joint = 0; joint < count; joint++)
+		{ // per joint
+		__m128 rotation = _mm_load_ps(&rotations[joint].x);
+		__m128 lengthSquared = SumLanes(_mm_mul_ps(rotation, rotation));
+		__m128 unit = _mm_div_ps(rotation, _mm_sqrt_ps(lengthSquared));
+		// a zero sum has no direction, so it is no rotation
+		__m128 zero = _mm_cmple_ps(lengthSquared, _mm_setzero_ps());
+		_mm_store_ps(&rotations[joint].x, _mm_or_ps(_mm_and_ps(zero, identity), _mm_andnot_ps(zero, unit)));
+		} // per joint
+#elif defined(POSEKERNELS_NEON)
+	for (int joint = 0; joint < count; joint++)
+		{ // per joint
+		float32x4_t rotation = vld1q_f32(&rotations[joint].x);
+		float lengthSquared = SumLanes(vmulq_f32(rotation, rotation));
+		if (lengthSquared <= 0.0f)
+			rotations[joint] = Quaternion();
+		else
+			vst1q_f32(&rotations[joint].x, vmulq_n_f32(rotation, 1.0f / sqrtf(lengthSquared)));
+		} // per joint
+#else
+	for (int joint = 0; joint < count; joint++)
+		{ // per joint
+		float lengthSquared = rotations[joint].dot(rotations[joint]);
+		rotations[joint] = lengthSquared <= 0.0f ? Quaternion() : rotations[joint] * (1.0f / sqrtf(lengthSquared));
+		} // per joint
+#endif
+	} // NormalizeRotations()
+
+// the squared distance between two feature vectors
+float SquaredDistance(const float *first, const float *second, int count)
+	{ // SquaredDistance()
+#if defined(POSEKERNELS_SSE)
+	__m128 sum = _mm_setzero_ps();
+	for (int value = 0; value < count; value += 4)
+		{ // per four values
+		__m128 difference = _mm_sub_ps(_mm_load_ps(first + value), _mm_load_ps(second + value));
+		sum = _mm_add_ps(sum, _mm_mul_ps(difference, difference));
+		} // per four values
+	return _mm_cvtss_f32(SumLanes(sum));
+#elif defined(POSEKERNELS_NEON)
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	for (int value = 0; value < count; value += 4)
+		{ // per four values
+		float32x4_t difference = vsubq_f32(vld1q_f32(first + value), vld1q_f32(second + value));
+		sum = vmlaq_f32(sum, difference, difference);
+		} // per four values
+	return SumLanes(sum);
+#else
+	float sum = 0.0f;
+	for (int value = 0; value < count; value++)
+		{ // per value
+		float difference = first[value] - second[value];
+		sum += difference * difference;
+		} // per value
+	return sum;
+#endif
+	} // SquaredDistance()
+
+// the squared distance from a feature vector to a box
+float BoxDistance(const float *point, const float *low, const float *high, int count)
+	{ // BoxDistance()
+#if defined(POSEKERNELS_SSE)
+	__m128 sum = _mm_setzero_ps();
+	for (int value = 0; value < count; value += 4)
+		{ // per four values
+		// at most one of these is positive, and neither is inside the box
+		__m128 x = _mm_load_ps(point + value);
+		__m128 outside = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_load_ps(low + value), x), _mm_sub_ps(x, _mm_load_ps(high + value))), _mm_setzero_ps());
+		sum = _mm_add_ps(sum, _mm_mul_ps(outside, outside));
+		} // per four values
+	return _mm_cvtss_f32(SumLanes(sum));
+#elif defined(POSEKERNELS_NEON)
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	for (int value = 0; value < count; value += 4)
+		{ // per four values
+		float32x4_t x = vld1q_f32(point + value);
+		float32x4_t outside = vmaxq_f32(vmaxq_f32(vsubq_f32(vld1q_f32(low + value), x), vsubq_f32(x, vld1q_f32(high + value))), vdupq_n_f32(0.0f));
+		sum = vmlaq_f32(sum, outside, outside);
+		} // per four values
+	return SumLanes(sum);
+#else
+	float sum = 0.0f;
+	for (int value = 0; value < count; value++)
+		{ // per value
+		float outside = std::max(std::max(low[value] - point[value], point[value] - high[value]), 0.0f);
+		sum += outside * outside;
+		} // per value
+	return sum;
+#endif
+	} // BoxDistance()
+
+// a rotation about one axis, with the axis fixed at compile time
+template <int Axis>
+static inline Quaternion AxisQuaternion(const Cartesian3 &degrees)
+	{ // AxisQuaternion()
+	float halfTheta = 0.5f * DEG2RAD(degrees[Axis]);
+	float sine = sinf(halfTheta);
+	return Quaternion(Axis == 0 ? sine : 0.0f, Axis == 1 ? sine : 0.0f, Axis == 2 ? sine : 0.0f, cosf(halfTheta));
+	} // AxisQuaternion()
+
+// Euler angles composed in an order fixed at compile time (the first axis is outermost)
+template <int... Axes>
+static Quaternion FixedEuler(const Cartesian3 &degrees)
+	{ // FixedEuler()
+	return (Quaternion() * ... * AxisQuaternion<Axes>(degrees));
+	} // FixedEuler()
+
+// the converter for each order, by its axes
+struct OrderedConverter
+	{ // struct OrderedConverter
+	int order[3];
+	EulerConverter converter;
+	}; // struct OrderedConverter
+
+static const OrderedConverter orderedConverters[] =
+	{ // orderedConverters
+	{ { -1, -1, -1 }, FixedEuler<> },
+	{ { 0, -1, -1 }, FixedEuler<0> },
+	{ { 1, -1, -1 }, FixedEuler<1> },
+	{ { 2, -1, -1 }, FixedEuler<2> },
+	{ { 0, 1, -1 }, FixedEuler<0, 1> },
+	{ { 0, 2, -1 }, FixedEuler<0, 2> },
+	{ { 1, 0, -1 }, FixedEuler<1, 0> },
+	{ { 1, 2, -1 }, FixedEuler<1, 2> },
+	{ { 2, 0, -1 }, FixedEuler<2, 0> },
+	{ { 2, 1, -1 }, FixedEuler<2, 1> },
+	{ { 0, 1, 2 }, FixedEuler<0, 1, 2> },
+	{ { 0, 2, 1 }, FixedEuler<0, 2, 1> },
+	{ { 1, 0, 2 }, FixedEuler<1, 0, 2> },
+	{ { 1, 2, 0 }, FixedEuler<1, 2, 0> },
+	{ { 2, 0, 1 }, FixedEuler<2, 0, 1> },
+	{ { 2, 1, 0 }, FixedEuler<2, 1, 0> }
+	}; // orderedConverters
+
+// the converter compiled for a joint's order of rotation axes
+EulerConverter EulerConverterFor(const int *order)
+	{ // EulerConverterFor()
+	for (const OrderedConverter &candidate : orderedConverters)
+		if (candidate.order[0] == order[0] && candidate.order[1] == order[1] && candidate.order[2] == order[2])
+			return candidate.converter;
+	return nullptr;
+	} // EulerConverterFor()
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	PoseKernels.h
+//	------------------------
+//
+//	The inner loops of posing a skeleton: forward
+//	kinematics, blending two sets of rotations, and
+//	converting Euler angles to quaternions. Each comes as
+//	a generic loop and as versions compiled for a fixed
+//	joint count or rotation order, with fixed-length loops
+//	and scratch space on the stack; a skeleton picks the
+//	matching versions as it is built.
+//
+///////////////////////////////////////////////////
+
+#ifndef _POSEKERNELS_H
+#define _POSEKERNELS_H
+
+#include "Cartesian3.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+
+class Skeleton;
+
+// the kernels for skeletons with one joint count
+struct PoseKernels
+	{ // struct PoseKernels
+	// the joint count they were compiled for, or 0 for the generic loops
+	int jointCount;
+
+	// a name for reports
+	const char *name;
+
+	// model-space transforms of every joint from its rotation and offset
+	void (*forwardKinematics)(const Skeleton &skeleton, const Quaternion *rotations, Matrix4 *model);
+
+	// nlerp every joint's rotation a fraction t of the way from one set to another
+	void (*blendRotations)(const Skeleton &skeleton, const Quaternion *from, const Quaternion *to, float t, Quaternion *blended);
+
+	// the two above in one, with the blended rotations kept on the stack
+	void (*blendPose)(const Skeleton &skeleton, const Quaternion *from, const Quaternion *to, float t, Matrix4 *model);
+	}; // struct PoseKernels
+
+// one joint's model transform from its rotation, its offset and its parent's model
+// transform (nullptr for a root); every transform is rigid, so only the top three rows
+// of the product are worked out (with SSE where Matrix4 uses it), as in every kernel
+void JointTransform(const Matrix4 *parent, const Quaternion &rotation, const Cartesian3 &offset, Matrix4 &model);
+
+// the kernels compiled for a joint count, or the generic ones if there are none; the
+// compiled ones take joint 0 as the only root, so they need a rootCount of 1
+const PoseKernels &PoseKernelsFor(int jointCount, int rootCount);
+
+// the generic kernels, which work for any joint count
+const PoseKernels &GenericPoseKernels();
+
+// add weight times each of a set of rotations to a running sum, first flipping any that
+// lies on the far side of the matching reference rotation so that every input is
+// blended along the shorter arc; with NormalizeRotations after the last input, this is an
+// n-way nlerp (SSE or NEON where Matrix4 uses them)
+void AccumulateRotations(const Quaternion *reference, const Quaternion *rotations, float weight, Quaternion *sum, int count);
+
+// scale each of a set of rotations to unit length (a zero one becomes the identity)
+void NormalizeRotations(Quaternion *rotations, int count);
+
+// the squared distance between two feature vectors, each 16-byte aligned with a
+// multiple of four floats (SSE or NEON where Matrix4 uses them)
+float SquaredDistance(const float *first, const float *second, int count);
+
+// the squared distance from a feature vector to the nearest point of a box, given by its
+// lowest and highest value on each axis (laid out and aligned as for SquaredDistance)
+float BoxDistance(const float *point, const float *low, const float *high, int count);
+
+// converts one joint's Euler angles in degrees to a quaternion
+typedef Quaternion (*EulerConverter)(const Cartesian3 &degrees);
+
+// the converter compiled for a joint's order of rotation axes (3 entries, -1 after the
+// last where the joint has fewer than three rotation channels); every order of up to
+// three distinct axes has one, and anything else (a repeated axis) gives nullptr, to
+// be converted by Quaternion::Euler's loop instead
+EulerConverter EulerConverterFor(const int *order);
+
+#endif
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Quaternion.cpp
+//	------------------------
+//
+//	A minimal class for a unit quaternion, used to hold
+//	joint rotations. Clips are converted from Euler angles
+//	once when they are loaded, so playing, blending and
+//	forward kinematics need no trigonometry.
+//
+///////////////////////////////////////////////////
+
+#include "Quaternion.h"
+#include <math.h>
+
+// the rotation loads as one register, like Homogeneous4
+static_assert(sizeof(Quaternion) == 4 * sizeof(float), "Quaternion must be four packed floats");
+
+// constructors
+Quaternion::Quaternion()
+    : x(0.0), y(0.0), z(0.0), w(1.0)
+    {}
+
+Quaternion::Quaternion(float X, float Y, float Z, float W)
+    : x(X), y(Y), z(Z), w(W)
+    {}
+
+// rotation by an angle in degrees about the x, y or z axis
+Quaternion Quaternion::AxisAngle(int axis, float degrees)
+    { // Quaternion::AxisAngle()
+    float halfTheta = 0.5f * DEG2RAD(degrees);
+    Quaternion returnVal(0.0f, 0.0f, 0.0f, cosf(halfTheta));
+    (&returnVal.x)[axis] = sinf(halfTheta);
+    return returnVal;
+    } // Quaternion::AxisAngle()
+
+// rotation by Euler angles in degrees, composed in the given order of axes
+Quaternion Quaternion::Euler(const Cartesian3 &degrees, const int *order)
+    { // Quaternion::Euler()
+    Quaternion returnVal;
+    for (int slot = 0; slot < 3 && order[slot] >= 0; slot++)
+        returnVal = returnVal * AxisAngle(order[slot], degrees[order[slot]]);
+    return returnVal;
+    } // Quaternion::Euler()
+
+// composition: rotates by other, then by this
+Quaternion Quaternion::operator *(const Quaternion &other) const
+    { // Quaternion::operator *()
+    return Quaternion(w * other.x + x * other.w + y * other.z - z * other.y,
+                      w * other.y - x * other.z + y * other.w + z * other.x,
+                      w * other.z + x * other.y - y * other.x + z * other.w,
+                      w * other.w - x * other.x - y * other.y - z * other.z);
+    } // Quaternion::operator *()
+
+// addition operator
+Quaternion Quaternion::operator +(const Quaternion &other) const
+    { // Quaternion::operator +()
+    return Quaternion(x + other.x, y + other.y, z + other.z, w + other.w);
+    } // Quaternion::operator +()
+
+// unary minus operator (the same rotation)
+Quaternion Quaternion::operator -() const
+    { // Quaternion::operator -()
+    return Quaternion(-x, -y, -z, -w);
+    } // Quaternion::operator -()
+
+// multiplication operator
+Quaternion Quaternion::operator *(float factor) const
+    { // Quaternion::operator *()
+    return Quaternion(x * factor, y * factor, z * factor, w * factor);
+    } // Quaternion::operator *()
+
+// dot product routine
+float Quaternion::dot(const Quaternion &other) const
+    { // Quaternion::dot()
+    return x * other.x + y * other.y + z * other.z + w * other.w;
+    } // Quaternion::dot()
+
+// the inverse of a unit quaternion
+Quaternion Quaternion::conjugate() const
+    { // Quaternion::conjugate()
+    return Quaternion(-x, -y, -z, w);
+    } // Quaternion::conjugate()
+
+// normalisation routine
+Quaternion Quaternion::unit() const
+    { // Quaternion::unit()
+    float length = sqrtf(dot(*this));
+    // a degenerate blend falls back to no rotation
+    if (length <= 0.0f)
+        return Quaternion();
+    return *this * (1.0f / length);
+    } // Quaternion::unit()
+
+// rotate a vector
+Cartesian3 Quaternion::Rotate(const Cartesian3 &vector) const
+    { // Quaternion::Rotate()
+    // v + 2w (u x v) + 2 u x (u x v), with u the vector part
+    Cartesian3 u(x, y, z);
+    Cartesian3 twiceCross = u.cross(vector) * 2.0f;
+    return vector + twiceCross * w + u.cross(twiceCross);
+    } // Quaternion::Rotate()
+
+// the rotation as a matrix, followed by a translation
+Matrix4 Quaternion::GetMatrix(const Cartesian3 &translation) const
+    { // Quaternion::GetMatrix()
+    Matrix4 returnMatrix;
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xy = x * y, xz = x * z, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+    returnMatrix.coordinates[0][0] = 1.0f - 2.0f * (yy + zz);
+    returnMatrix.coordinates[0][1] = 2.0f * (xy - wz);
+    returnMatrix.coordinates[0][2] = 2.0f * (xz + wy);
+    returnMatrix.coordinates[0][3] = translation.x;
+    returnMatrix.coordinates[1][0] = 2.0f * (xy + wz);
+    returnMatrix.coordinates[1][1] = 1.0f - 2.0f * (xx + zz);
+    returnMatrix.coordinates[1][2] = 2.0f * (yz - wx);
+    returnMatrix.coordinates[1][3] = translation.y;
+    returnMatrix.coordinates[2][0] = 2.0f * (xz - wy);
+    returnMatrix.coordinates[2][1] = 2.0f * (yz + wx);
+    returnMatrix.coordinates[2][2] = 1.0f - 2.0f * (xx + yy);
+    returnMatrix.coordinates[2][3] = translation.z;
+    returnMatrix.coordinates[3][3] = 1.0f;
+    return returnMatrix;
+    } // Quaternion::GetMatrix()
+
+// normalised linear interpolation along the shorter arc
+Quaternion Quaternion::Nlerp(const Quaternion &from, const Quaternion &to, float t)
+    { // Quaternion::Nlerp()
+    // q and -q are the same rotation: pick the one nearer the start
+    Quaternion end = from.dot(to) < 0.0f ? -to : to;
+    return (from * (1.0f - t) + end * t).unit();
+    } // Quaternion::Nlerp()
+
+// spherical linear interpolation along the shorter arc
+Quaternion Quaternion::Slerp(const Quaternion &from, const Quaternion &to, float t)
+    { // Quaternion::Slerp()
+    float cosTheta = from.dot(to);
+    Quaternion end = cosTheta < 0.0f ? -to : to;
+    cosTheta = fabsf(cosTheta);
+    // nearly parallel: the arc is a straight line to within float precision
+    if (cosTheta > 0.9995f)
+        return Nlerp(from, end, t);
+    float theta = acosf(cosTheta);
+    float sinTheta = sinf(theta);
+    return from * (sinf((1.0f - t) * theta) / sinTheta) + end * (sinf(t * theta) / sinTheta);
+    } // Quaternion::Slerp()
+
+// stream output
+std::ostream & operator << (std::ostream &outStream, const Quaternion &value)
+    { // operator <<
+    outStream << value.x << " " << value.y << " " << value.z << " " << value.w;
+    return outStream;
+    } // operator <<
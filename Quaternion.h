@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Quaternion.h
+//	------------------------
+//
+//	A minimal class for a unit quaternion, used to hold
+//	joint rotations. Clips are converted from Euler angles
+//	once when they are loaded, so playing, blending and
+//	forward kinematics need no trigonometry.
+//
+///////////////////////////////////////////////////
+
+#ifndef QUATERNION_H
+#define QUATERNION_H
+
+#include <iostream>
+#include "Cartesian3.h"
+#include "Matrix4.h"
+
+// the class - four packed floats, aligned so that a rotation loads as one SIMD register
+class alignas(16) Quaternion
+    { // Quaternion
+    public:
+    // the vector part and the scalar part
+    float x, y, z, w;
+
+    // constructors: the default is the identity rotation
+    Quaternion();
+    Quaternion(float X, float Y, float Z, float W);
+
+    // rotation by an angle in degrees about the x, y or z axis (0, 1 or 2)
+    static Quaternion AxisAngle(int axis, float degrees);
+
+    // rotation by Euler angles in degrees, composed in the given order of axes
+    // (as a bvh joint lists its channels: the first is outermost; -1 ends the list)
+    static Quaternion Euler(const Cartesian3 &degrees, const int *order);
+
+    // composition: rotates by other, then by this
+    Quaternion operator *(const Quaternion &other) const;
+
+    // component-wise operators, for interpolation
+    Quaternion operator +(const Quaternion &other) const;
+    Quaternion operator -() const;
+    Quaternion operator *(float factor) const;
+
+    // dot product routine
+    float dot(const Quaternion &other) const;
+
+    // the inverse of a unit quaternion
+    Quaternion conjugate() const;
+
+    // normalisation routine
+    Quaternion unit() const;
+
+    // rotate a vector
+    Cartesian3 Rotate(const Cartesian3 &vector) const;
+
+    // the rotation as a matrix, followed by a translation
+    // (the same as Matrix4::Translate(translation) * rotation matrix)
+    Matrix4 GetMatrix(const Cartesian3 &translation = Cartesian3()) const;
+
+    // normalised linear interpolation along the shorter arc: cheap, and close to
+    // slerp for the small angles between neighbouring poses
+    static Quaternion Nlerp(const Quaternion &from, const Quaternion &to, float t);
+
+    // spherical linear interpolation along the shorter arc, at constant angular speed
+    static Quaternion Slerp(const Quaternion &from, const Quaternion &to, float t);
+    }; // Quaternion
+
+// stream output
+std::ostream & operator << (std::ostream &outStream, const Quaternion &value);
+
+#endif
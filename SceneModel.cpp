@@ -13,7 +13,10 @@
 ///////////////////////////////////////////////////
 
 #include "SceneModel.h"
+#include "AssetLoader.h"
+#include "GaitTrack.h"
 #include <math.h>
+#include <cstdlib>
 
 // three local variables with the hardcoded file names
 const char* groundModelName		= "./models/randomland.dem";
@@ -23,7 +26,30 @@ const char* motionBvhRun		= "./models/fast_run.bvh";
 const char* motionBvhveerLeft	= "./models/veer_left.bvh";
 const char* motionBvhveerRight	= "./models/veer_right.bvh";
 const char *motionBvhWalk = "./models/walking.bvh";
+const char *animationDatabaseName = "./models/animations.adb";
+// every clip is resampled to this frame time as it is loaded, so that clips from
+// different capture rigs share one time base and line up frame for frame when blended
+// (0 leaves each clip at its own rate)
+const float engineFrameTime = 1.0f / 24.0f;
+// the most each clip's baked poses may take (a frame of the 65-joint rig is about 4 KiB)
+const size_t poseCacheBytes = 1 << 20;
+// the crowd is a square of this many characters a side, this far apart
+const int crowdSide = 16;
+const float crowdSpacing = 4.0f;
+// how long a blend from one cycle into the next lasts, and how long one between two
+// cycles kept in step on their phase needs (the strides already line up, so the blend
+// only has to hide the change of style)
+const float blendSeconds = 0.5f;
+const float syncedBlendSeconds = 0.25f;
+// the longest an inertialized transition's offset takes to die away
+const float inertialSeconds = 0.3f;
+// how often motion matching looks for a better frame, and how many frames either side of
+// the one playing are not worth jumping to
+const float searchSeconds = 0.1f;
+const int matchSlack = 2;
 const float cameraSpeed = 0.5;
+// the clips are in centimetres, drawn at a tenth of that in the scene
+const float characterScale = 0.1f;
 
 const Homogeneous4 sunDirection(0.5, -0.5, 0.3, 1.0);
 const GLfloat groundColour[4] = { 0.2, 0.5, 0.2, 1.0 };
@@ -35,16 +61,35 @@ const GLfloat blackColour[4] = {0.0, 0.0, 0.0, 1.0};
 // constructor
 SceneModel::SceneModel()
 	{ // constructor
-	// load the object models from files
-	groundModel.ReadFileTerrainData(groundModelName, 3);
+	// map the precompiled clips, if they have been built
+	animationDatabase.Open(animationDatabaseName);
 
+	// the assets are independent, so load them all at once and wait for them
+	AssetLoader loader;
+	// load the object models from files
+	loader.Add(groundModelName, [this]() { return groundModel.ReadFileTerrainData(groundModelName, 3); });
 	// load the animation data from files
-	restPose.ReadFileBVH(motionBvhStand);
-	runCycle.ReadFileBVH(motionBvhRun);
-	veerLeftCycle.ReadFileBVH(motionBvhveerLeft);
-	veerRightCycle.ReadFileBVH(motionBvhveerRight);
-    walking.ReadFileBVH(motionBvhWalk);
+	loader.Add(motionBvhStand, [this]() { return LoadClip(motionBvhStand, restPose); });
+	loader.Add(motionBvhRun, [this]() { return LoadClip(motionBvhRun, runCycle); });
+	loader.Add(motionBvhveerLeft, [this]() { return LoadClip(motionBvhveerLeft, veerLeftCycle); });
+	loader.Add(motionBvhveerRight, [this]() { return LoadClip(motionBvhveerRight, veerRightCycle); });
+	loader.Add(motionBvhWalk, [this]() { return LoadClip(motionBvhWalk, walking); });
+	loader.Run();
+	loader.Report(std::cout);
+    //the best frame to enter each cycle at from every frame of the others
+    transitions.Build({ runCycle, walking, veerLeftCycle, veerRightCycle, restPose });
+    std::cout << "transition table: " << transitions.ClipCount() << " clips in " << transitions.buildSeconds * 1000.0
+              << " ms on " << transitions.threadsUsed << " threads" << std::endl;
+    //and every frame of them, for motion matching
+    motionDatabase.Build({ runCycle, walking, veerLeftCycle, veerRightCycle, restPose });
     currCycle = restPose;
+    desiredCycle = restPose;
+    // the character plays through a blend tree, mixing the cycle it leaves into the next
+    leavingNode = blendTree.AddClip(restPose);
+    playingNode = blendTree.AddClip(restPose);
+    mixNode = blendTree.AddLerp({ leavingNode, playingNode });
+    //with an inertial node on top, which only changes the pose in an inertialized transition
+    outputNode = blendTree.AddInertial(mixNode, inertialSeconds);
     // set the world to opengl matrix
     world2OpenGLMatrix = Matrix4::RotateX(90.0);
     CameraTranslateMatrix = Matrix4::Translate(Cartesian3(-5, 15, -15.5));
@@ -53,19 +98,128 @@ SceneModel::SceneModel()
     // initialize the character's position and rotation
     EventCharacterReset();
 
-    // and set the frame number to 0
-    frameNumber = 0;
+    // and start with no blend
+    blending = false;
+    blendingTime = 0.0f;
+    blendDuration = blendSeconds;
+    blendSynced = false;
 
     } // constructor
 
-    // routine that updates the scene for the next frame
-    void SceneModel::Update()
+    // load a clip from the database if it holds it, otherwise from the bvh file
+    bool SceneModel::LoadClip(const char *fileName, ClipHandle &clip)
+    { // LoadClip()
+    // the clip is only modifiable until it is published through the handle
+    std::shared_ptr<BVHData> loaded = std::make_shared<BVHData>();
+    bool success = animationDatabase.BindClip(AnimationDatabase::ClipName(fileName), *loaded)
+                   || loaded->ReadFileBVH(fileName);
+    //the frames are put on the engine's time base before anything is worked out from them
+    if (success && engineFrameTime > 0.0f)
+        loaded->Resample(engineFrameTime);
+    //the cycles loop forever, so each frame's pose is worked out once here rather than on every loop
+    if (success)
+        loaded->CachePoses(poseCacheBytes, true);
+    //and where its feet are planted and how far through its stride each frame is, for syncing blends
+    if (success)
+        loaded->AnnotateGait();
+    clip = loaded;
+    return success;
+    } // LoadClip()
+
+    // routine that advances the scene by a number of seconds
+    void SceneModel::Update(float seconds)
     { // Update()
-    // increment the frame counter
-    frameNumber++;
-
+    // the crowd is animated on every core
+    if (crowdMode)
+        crowd.Update(seconds);
+    //in motion matching, look for a better frame every so often
+    if (motionMatching && !crowdMode) {
+        sinceSearch += seconds;
+        if (sinceSearch >= searchSeconds) {
+            sinceSearch = 0.0f;
+            matchMotion();
+        }
+    }
+    // both clips of a blend play on, the new one showing more and more of the pose
+    float weight = 1.0f;
+    if (blending) {
+        blendingTime += seconds;
+        weight = std::min(blendingTime / blendDuration, 1.0f);
+    }
+    const BlendTree::Node &leaving = blendTree.nodes[leavingNode];
+    const BlendTree::Node &playing = blendTree.nodes[playingNode];
+    //in step, both take a stride as long as the blend of theirs, so their phases stay together
+    float leavingRate = 1.0f, playingRate = 1.0f;
+    if (blending && blendSynced) {
+        float leavingStride = leaving.clip->gait->StrideSeconds(leaving.time);
+        float playingStride = playing.clip->gait->StrideSeconds(playing.time);
+        float stride = leavingStride * (1.0f - weight) + playingStride * weight;
+        leavingRate = leavingStride / stride;
+        playingRate = playingStride / stride;
+    }
+    blendTree.SetRate(leavingNode, leavingRate);
+    blendTree.SetRate(playingNode, playingRate);
+    //the character moves by each clip's root motion in proportion to how much it shows
+    //(but stands still while the crowd is shown in its place)
+    if (!crowdMode) {
+        if (blending)
+            applyClipMotion(*leaving.clip, leaving.time, seconds * leavingRate, 1.0f - weight);
+        applyClipMotion(*playing.clip, playing.time, seconds * playingRate, weight);
+    }
+    blendTree.Advance(seconds);
+    if (weight >= 1.0f)
+        blending = false;
+    blendTree.SetWeight(mixNode, 0, 1.0f - weight);
+    blendTree.SetWeight(mixNode, 1, weight);
     } // Update()
 
+    // jump to the frame that best carries on towards the desired cycle's motion
+    void SceneModel::matchMotion()
+    { // matchMotion()
+    const BlendTree::Node &playing = blendTree.nodes[playingNode];
+    int clip = motionDatabase.ClipIndex(*playing.clip);
+    if (clip < 0)
+        return;
+    int frame = std::min(FrameAt(*playing.clip, playing.time), playing.clip->frame_count - 1);
+    int row = motionDatabase.Row(clip, frame);
+    //the trajectory of moving the way the desired cycle moves, from the pose playing
+    Cartesian3 velocity;
+    float turnRate;
+    MotionDatabase::ClipMotion(*desiredCycle, velocity, turnRate);
+    float trajectory[MotionDatabase::trajectoryFeatures];
+    MotionDatabase::ConstantTrajectory(velocity, turnRate, trajectory);
+    alignas(16) float query[MotionDatabase::stride];
+    motionDatabase.Query(row, trajectory, query);
+    MotionMatch match = motionDatabase.Search(query, row);
+    //a frame close to the one playing, either way round the loop, is not worth a transition
+    int apart = std::abs(match.frame - frame);
+    if (match.clip == clip && std::min(apart, playing.clip->frame_count - apart) <= matchSlack)
+        return;
+    //otherwise jump straight to it, letting the difference die away
+    const ClipHandle &next = motionDatabase.Clip(match.clip);
+    blendTree.Play(playingNode, next, match.frame * next->frame_time);
+    blendTree.SetWeight(mixNode, 0, 0.0f);
+    blendTree.SetWeight(mixNode, 1, 1.0f);
+    blendTree.Transition(outputNode);
+    blending = false;
+    currCycle = next;
+    } // matchMotion()
+
+    // move the character by a share of a clip's root motion over some seconds from a time
+    void SceneModel::applyClipMotion(const BVHData &clip, float time, float seconds, float weight)
+    { // applyClipMotion()
+    if (clip.frame_count == 0 || clip.frame_time <= 0.0f || weight <= 0.0f)
+        return;
+    //the character moves by the part of each frame's root motion the step covers
+    float start = time / clip.frame_time;
+    float end = (time + seconds) / clip.frame_time;
+    for (int frame = (int) floorf(start); frame < end; frame++) {
+        float covered = std::min(end, frame + 1.0f) - std::max(start, (float) frame);
+        if (covered > 0.0f)
+            applyRootMotion(clip, frame % clip.frame_count, covered * weight);
+    }
+    } // applyClipMotion()
+
     // routine to tell the scene to render itself
     void SceneModel::Render()
     { // Render()
@@ -112,38 +266,30 @@ SceneModel::SceneModel()
 
     // now set the colour to draw the bones
     glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, boneColour);
-    //set the rotation based on the direction the character is running in
-    if (runDir == "right") {
-        totalRotation = 90.0f;
-    } else if (runDir == "left") {
-        totalRotation = -90.0f;
-    } else {
-        totalRotation = 0.0f;
+    //in crowd mode, the crowd stands in for the character
+    if (crowdMode) {
+        for (int character = 0; character < crowd.Size(); character++) {
+            //stood on the ground under its root, like the character
+            const Matrix4 &characterMatrix = crowd.world[character];
+            Cartesian3 root = characterMatrix * (clipToScene * crowd.pose[character].Position(0) * characterScale);
+            Matrix4 moveMat = viewMatrix * characterMatrix
+                              * Matrix4::Translate(Cartesian3(0, 0, groundModel.getHeight(root.x, root.y)));
+            crowd.clip[character]->Render(moveMat, characterScale, crowd.pose[character]);
+        }
+        return;
     }
 
-    //run this when we are blending
-    if (frameNumber >= blendingStartFrame && frameNumber < blendingEndFrame) {
-        //calculate the tranformation by the character location and rotation
-        Matrix4 blendedMoveMat = viewMatrix * Matrix4::Translate(characterLocation)
-                                 * characterRotation;
-        //move the character according to the ground height
-        Cartesian3 pos = (Matrix4::Translate(characterLocation) * characterRotation).column(3).Vector();
-        blendedMoveMat = blendedMoveMat * Matrix4::Translate(Cartesian3(0,0,groundModel.getHeight(pos.x, pos.y)));
-        blendedAnimation.Render(blendedMoveMat, 0.1f, frameNumber - blendingStartFrame - 1);
-    }
-    //run this if we are not blending
-    else {
-        int animationFrame = (frameNumber - blendingEndFrame) % currCycle.frame_count;
-        calcRotation(animationFrame);
-        characterLocation = characterLocation + characterRotation * characterSpeed;
-        Matrix4 moveMat = viewMatrix * Matrix4::Translate(characterLocation) * characterRotation;
-
-
-        Cartesian3 pos = (Matrix4::Translate(characterLocation) * characterRotation).column(3).Vector();
-        //move the character according to the ground height
-        moveMat = moveMat * Matrix4::Translate(Cartesian3(0,0,groundModel.getHeight(pos.x, pos.y)));
-        currCycle.Render(moveMat, 0.1f, animationFrame);
-    }
+    //evaluate the character's pose once for this frame, through the blend tree, on the
+    //skeleton of the clip being played
+    blendTree.Evaluate(outputNode, *currCycle, characterPose);
+
+    //calculate the tranformation by the character location and rotation
+    Matrix4 characterMatrix = Matrix4::Translate(characterLocation) * characterRotation;
+    //move the character according to the ground height under its root
+    Cartesian3 root = characterMatrix * (clipToScene * characterPose.Position(0) * characterScale);
+    Matrix4 moveMat = viewMatrix * characterMatrix
+                      * Matrix4::Translate(Cartesian3(0, 0, groundModel.getHeight(root.x, root.y)));
+    currCycle->Render(moveMat, characterScale, characterPose);
 
     //walking.Render(viewMatrix, 0.1f, (frameNumber) % walking.frame_count);
     } // Render()
@@ -218,7 +364,6 @@ void SceneModel::EventCharacterTurnLeft()
     { // EventCharacterForward()
         if(runDir != "forward"){
            blendAnimation("forward", runCycle);
-           this->characterSpeed = Cartesian3(0, -0.4f, 0);
         }
 
     } // EventCharacterForward()
@@ -227,7 +372,6 @@ void SceneModel::EventCharacterTurnLeft()
     { // EventCharacterBackward()
         if(runDir != "rest"){
          blendAnimation("rest", restPose);
-         this->characterSpeed = Cartesian3(0, 0, 0);
         }
 
     } // EventCharacterBackward()
@@ -236,60 +380,113 @@ void SceneModel::EventCharacterTurnLeft()
     void SceneModel::EventCharacterReset()
     { // EventCharacterReset()
     this->characterLocation = Cartesian3(0, 0, 0);
-    this->characterSpeed = Cartesian3(0, 0, 0);
     this->characterRotation = Matrix4::Identity();
     currCycle = restPose;
     runDir = "rest";
+    desiredCycle = restPose;
+    //straight into the rest pose, with no blend
+    blendTree.Play(playingNode, restPose, 0.0f);
+    blendTree.SetWeight(mixNode, 0, 0.0f);
+    blendTree.SetWeight(mixNode, 1, 1.0f);
+    blending = false;
     } // EventCharacterReset()
 
-    float SceneModel::calcRotation(int animationFrame)
-    {
-        //calculate the angle in deg of how much the character should rotate each frame (based on the start and end frame which can be eddited in the header)
-    if (animationFrame >= startFrame && animationFrame < endFrame) {
-        float relativeRotation = totalRotation / (endFrame - startFrame);
-        //update the character rotation
-        characterRotation = Matrix4::RotateZ(relativeRotation) * characterRotation;
-        return relativeRotation;
-    }
-    }
-    void SceneModel::blendBonerotations(std::vector<std::vector<Cartesian3>> &boneRotations,
-                                        int animationFrame)
-    {
-    //number of steps to blend the animation in (12 frames is roughly 0.5s as our renderer is running at 24 fps)
-    int blendSteps = 12;
-    float t = 1.0f;
-    float tStep = t / (blendSteps - 1.0f);
-    //resize the bonerotaions of the blended animation
-    blendedAnimation.boneRotations.resize(blendSteps);
-    for(int i =0; i < blendSteps; ++i){
-        blendedAnimation.boneRotations[i].resize(65);
-    }
-    for (int i = 0; i < blendSteps; ++i) {
-        for (int joint = 0; joint < boneRotations[0].size(); ++joint) {
-            //do linear interpolation between the two angles and save them in the vector
-            blendedAnimation.boneRotations[i][joint] = std::max(t, 0.0f)
-                                                           * boneRotations[animationFrame][joint]
-                                                       + ((1.0f - t) <= 1.0f ? (1.0f - t) : 1.0f)
-                                                             * currCycle.boneRotations[0][joint];
+    // switch between the character and a crowd: c
+    void SceneModel::EventToggleCrowd()
+    { // EventToggleCrowd()
+    crowdMode = !crowdMode;
+    if (!crowdMode || crowd.Size() > 0)
+        return;
+    //the first time, fill a square around the character with others wandering between the cycles
+    std::vector<ClipHandle> cycles = { runCycle, walking, veerLeftCycle, veerRightCycle, restPose };
+    crowd.scale = characterScale;
+    for (int row = 0; row < crowdSide; row++)
+        for (int col = 0; col < crowdSide; col++) {
+            int character = row * crowdSide + col;
+            Cartesian3 start = characterLocation
+                               + Cartesian3((col - crowdSide / 2) * crowdSpacing, (row - crowdSide / 2) * crowdSpacing, 0);
+            crowd.Add(cycles[character % cycles.size()], start, (float) (character * 37 % 360), 0.0f);
+        }
+    crowd.Wander(cycles, 4.0f, 0.5f);
+    crowd.Update(0.0f);
+    } // EventToggleCrowd()
+
+    // switch motion matching on and off
+    void SceneModel::EventToggleMotionMatching()
+    { // EventToggleMotionMatching()
+    motionMatching = !motionMatching;
+    //aiming for the cycle the keys last chose, from the next update
+    sinceSearch = searchSeconds;
+    } // EventToggleMotionMatching()
+
+    // switch between crossfaded and inertialized transitions
+    void SceneModel::EventToggleTransitions()
+    { // EventToggleTransitions()
+    inertialTransitions = !inertialTransitions;
+    } // EventToggleTransitions()
+
+    // move the character by a fraction of a clip's root motion over a frame
+    void SceneModel::applyRootMotion(const BVHData &clip, int animationFrame, float fraction)
+    { // applyRootMotion()
+    //the track was extracted when the clip was loaded, so this is a single lookup
+    const RootMotionDelta &step = clip.RootMotion(animationFrame);
+    //the clip is y-up with z forward, so it is turned onto the ground the same way the skeleton is drawn
+    Cartesian3 stepOnGround = clipToScene * step.translation * (characterScale * fraction);
+    characterLocation = characterLocation + characterRotation * stepOnGround;
+    //a turn about the clip's vertical axis is a turn about z in the scene
+    if (step.yaw != 0.0f)
+        characterRotation = characterRotation * Matrix4::RotateZ(step.yaw * fraction);
+    } // applyRootMotion()
+    void SceneModel::blendAnimation(std::string newPose, const ClipHandle &nextBVH){
+        //in motion matching the keys only choose the motion to aim for, and the search
+        //(straight away) chooses the frames
+        if (motionMatching) {
+            desiredCycle = nextBVH;
+            runDir = newPose;
+            sinceSearch = searchSeconds;
+            return;
+        }
+        const BlendTree::Node &playing = blendTree.nodes[playingNode];
+        //between two cycles that step, the new one starts at the same point in its stride
+        const GaitTrack *leavingGait = playing.clip->gait.get();
+        const GaitTrack *nextGait = nextBVH->gait.get();
+        bool synced = leavingGait != nullptr && nextGait != nullptr && leavingGait->HasPhase() && nextGait->HasPhase();
+        float entryTime;
+        if (synced)
+            entryTime = nextGait->TimeAtPhase(leavingGait->Phase(playing.time));
+        else {
+            //otherwise from its frame nearest to the one being left, rather than its first
+            int leavingFrame = std::min(FrameAt(*playing.clip, playing.time), playing.clip->frame_count - 1);
+            entryTime = transitions.BestEntry(*playing.clip, leavingFrame, *nextBVH) * nextBVH->frame_time;
+        }
+        if (inertialTransitions) {
+            //the new cycle takes over at once, and the difference from the pose shown dies away
+            blendTree.Play(playingNode, nextBVH, entryTime);
+            blendTree.SetWeight(mixNode, 0, 0.0f);
+            blendTree.SetWeight(mixNode, 1, 1.0f);
+            blendTree.Transition(outputNode);
+            blending = false;
+        } else {
+            //a key pressed part way through a blend leaves a mix of two cycles on show
+            bool interrupted = blending;
+            //the cycle being played is left from where it is, and keeps playing as it fades out
+            blendTree.Play(leavingNode, playing.clip, playing.time);
+            //while the new one fades in
+            blendTree.Play(playingNode, nextBVH, entryTime);
+            blendTree.SetWeight(mixNode, 0, 1.0f);
+            blendTree.SetWeight(mixNode, 1, 0.0f);
+            blending = true;
+            blendingTime = 0.0f;
+            //kept in step, the blend can be shorter
+            blendSynced = synced;
+            blendDuration = synced ? syncedBlendSeconds : blendSeconds;
+            //which would pop to the cycle being left at full weight, so the difference
+            //from the mix dies away through the inertial node instead
+            if (interrupted)
+                blendTree.Transition(outputNode);
         }
-        t -= tStep;
-    }
-    }
-
-    void SceneModel::blendAnimation(std::string newPose, BVHData &nextBVH){
-        //save the boneRotations of the current animation cycle
-        std::vector<std::vector<Cartesian3>> currRotations = currCycle.boneRotations;
-        //check in which frame the animation is
-        int animationFrame = frameNumber % currCycle.frame_count;
-        // set the new blended cycle to be the current cycle
-        blendedAnimation = currCycle;
         //set the new animation cycle to be the current one
         currCycle = nextBVH;
-        //interpolate rotations
-        blendBonerotations(currRotations, animationFrame);
         //set new run direction
         runDir = newPose;
-        //set the frames to blend the animation in
-        blendingStartFrame = frameNumber;
-        blendingEndFrame = frameNumber + 13;
     }
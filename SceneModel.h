@@ -27,6 +27,12 @@
 #endif
 #include "Terrain.h"
 #include "BVHData.h"
+#include "AnimationDatabase.h"
+#include "Pose.h"
+#include "BlendTree.h"
+#include "Crowd.h"
+#include "MotionMatching.h"
+#include "TransitionTable.h"
 #include "Matrix4.h"
 
 class SceneModel										
@@ -35,40 +41,69 @@ class SceneModel
 	// a terrain model 
 	Terrain groundModel;
 
+	// precompiled clips, if the database has been built (see AnimationDatabase.h)
+	AnimationDatabase animationDatabase;
+
 	// animation cycles (which implicitly have geometric data for a character)
-	BVHData restPose;
-	BVHData runCycle;
-	BVHData veerLeftCycle;
-	BVHData veerRightCycle;
-    BVHData walking;
-    BVHData blendedAnimation;
+	// these are shared, immutable clips: switching between them copies a handle
+	ClipHandle restPose;
+	ClipHandle runCycle;
+	ClipHandle veerLeftCycle;
+	ClipHandle veerRightCycle;
+    ClipHandle walking;
     // location & orientation of character
     Cartesian3 characterLocation = Cartesian3(0, 0, 0);
     Matrix4 characterRotation = Matrix4::Identity();
-    BVHData currCycle;
+    ClipHandle currCycle;
     std::string runDir = "forward";
-    Cartesian3 characterSpeed = Cartesian3(0, -0.5f, 0);
     // a matrix that specifies the mapping from world coordinates to those assumed
     // by OpenGL
     Matrix4 world2OpenGLMatrix;
-    std::vector<std::vector<Cartesian3>> blendedBoneRotations;
+    // the character's blend tree: the clip being left and currCycle, each playing on from
+    // its own time, mixed by a lerp node (the one being left has no weight outside a blend)
+    BlendTree blendTree;
+    int leavingNode;
+    int playingNode;
+    int mixNode;
+    // and an inertial node over the mix, the pose drawn
+    int outputNode;
+    // whether a change of cycle switches at once and lets the difference die away, rather
+    // than crossfading
+    bool inertialTransitions = false;
+    // the frame of each cycle to enter at from every frame of the others
+    TransitionTable transitions;
+    // in motion matching, the character plays whichever frame of the cycles best carries
+    // on towards the motion of the cycle the arrow keys last chose, searched for every
+    // so often in a database of every frame
+    MotionDatabase motionDatabase;
+    bool motionMatching = false;
+    ClipHandle desiredCycle;
+    float sinceSearch = 0.0f;
+    // the character's joint transforms, evaluated once a frame and then drawn
+    Pose characterPose;
+    // a crowd wandering between the cycles, drawn instead of the character in crowd mode
+    Crowd crowd;
+    bool crowdMode = false;
     // matrix for user camera
     Matrix4 viewMatrix;
     Matrix4 CameraTranslateMatrix;
     Matrix4 CameraRotationMatrix;
-    int startFrame = 24;          // frame to start rotating
-    int endFrame = 33;            // frame to end rotation
-    float totalRotation = -90.0f; // Total rotation expected to be done by the character
-    // the frame number for use in animating
-    unsigned long frameNumber;
-    // the frame number for use in animating
-    unsigned long blendingStartFrame = -1;
-    unsigned long blendingEndFrame = 0;
+    // whether a blend into currCycle is playing, the seconds since it started and the
+    // seconds it lasts
+    bool blending;
+    float blendingTime;
+    float blendDuration;
+    // whether both cycles of the blend step, and so play kept in step on their phase
+    bool blendSynced;
     // constructor
     SceneModel();
 
-    // routine that updates the scene for the next frame
-    void Update();
+    // load a clip from the database if it holds it, otherwise from the bvh file
+    // (called from loader threads, so it only touches the clip it is given)
+    bool LoadClip(const char *fileName, ClipHandle &clip);
+
+    // routine that advances the scene by a number of seconds
+    void Update(float seconds);
 
     // routine to tell the scene to render itself
     void Render();
@@ -93,11 +128,25 @@ class SceneModel
 
 	// reset character to original position: p
 	void EventCharacterReset();
-    float calcRotation(int animationFrame);
+
+	// switch between the character and a crowd: c
+	void EventToggleCrowd();
+
+	// switch between crossfaded and inertialized transitions: i
+	void EventToggleTransitions();
+
+	// switch motion matching on and off: m
+	void EventToggleMotionMatching();
+    // jump to the frame that best carries on towards the desired cycle's motion, if it is
+    // not the one playing
+    void matchMotion();
+    // move the character by a share of a clip's root motion over some seconds from a time
+    void applyClipMotion(const BVHData &clip, float time, float seconds, float weight);
+    // move the character by a fraction of a clip's root motion over a frame
+    void applyRootMotion(const BVHData &clip, int animationFrame, float fraction);
     // needed for now for Xiaoyuan's code
     void EventSwitchMode();
-    void blendBonerotations(std::vector<std::vector<Cartesian3>> &boneRotations, int animationFrame);
-    void blendAnimation(std::string newPose, BVHData &newBVH);
+    void blendAnimation(std::string newPose, const ClipHandle &newBVH);
     }; // class SceneModel
 
 #endif
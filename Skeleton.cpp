@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Skeleton.cpp
+//	------------------------
+//	
+//	A flat skeleton stored as parallel arrays, one entry
+//	per joint in depth-first order. Parents always come
+//	before their children, so forward kinematics is a
+//	single loop from the root to the leaves.
+//	
+///////////////////////////////////////////////////
+
+#include "Skeleton.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+// decoded frames are written as plain arrays of floats
+static_assert(sizeof(Cartesian3) == 3 * sizeof(float), "Cartesian3 must be three packed floats");
+
+// the intern table: a deque so that references to names stay valid as it grows
+static std::mutex internLock;
+static std::deque<std::string> internedNames;
+static std::unordered_map<std::string, int> internedIds;
+
+// number of joints
+int Skeleton::JointCount() const
+	{ // JointCount()
+	return (int) parent.size();
+	} // JointCount()
+
+// number of floats in each frame
+int Skeleton::ChannelCount() const
+	{ // ChannelCount()
+	return (int) channels.size();
+	} // ChannelCount()
+
+// name of a joint
+const std::string &Skeleton::Name(int joint) const
+	{ // Name()
+	return InternedName(nameId[joint]);
+	} // Name()
+
+// index of the joint with a given name, or -1
+int Skeleton::FindJoint(const std::string &name) const
+	{ // FindJoint()
+	int id = InternName(name);
+	for (int joint = 0; joint < JointCount(); joint++)
+		if (nameId[joint] == id)
+			return joint;
+	return -1;
+	} // FindJoint()
+
+// index of the first joint whose name holds a piece of text, or -1
+int Skeleton::FindJointContaining(std::string_view text) const
+	{ // FindJointContaining()
+	for (int joint = 0; joint < JointCount(); joint++)
+		if (Name(joint).find(text) != std::string::npos)
+			return joint;
+	return -1;
+	} // FindJointContaining()
+
+// add a joint below a given parent; returns its index
+int Skeleton::AddJoint(const std::string &name, int parentJoint)
+	{ // AddJoint()
+	parent.push_back(parentJoint);
+	offset.push_back(Cartesian3(0.0f, 0.0f, 0.0f));
+	firstChannel.push_back(ChannelCount());
+	channelCount.push_back(0);
+	nameId.push_back(InternName(name));
+	rotationOrder.insert(rotationOrder.end(), 3, -1);
+	eulerConverter.push_back(EulerConverterFor(&rotationOrder[rotationOrder.size() - 3]));
+	kernels = &PoseKernelsFor(JointCount(), (int) std::count(parent.begin(), parent.end(), -1));
+	return JointCount() - 1;
+	} // AddJoint()
+
+// add a channel to the most recently added joint
+void Skeleton::AddChannel(int channelId)
+	{ // AddChannel()
+	int joint = JointCount() - 1;
+	int column = ChannelCount();
+	channels.push_back(channelId);
+	channelCount.back()++;
+
+	// compile the channel into the decode table (ids as in BVHData::BVH_CHANNEL)
+	if (channelId >= 3 && channelId <= 5)
+		{ // rotation
+		int axis = channelId - 3;
+		rotationSource.push_back(column);
+		rotationTarget.push_back(3 * joint + axis);
+		for (int slot = 0; slot < 3; slot++)
+			if (rotationOrder[3 * joint + slot] < 0)
+				{ // next free slot
+				rotationOrder[3 * joint + slot] = axis;
+				break;
+				} // next free slot
+		eulerConverter[joint] = EulerConverterFor(&rotationOrder[3 * joint]);
+		} // rotation
+	else if (channelId >= 0 && channelId <= 2 && joint == 0)
+		{ // root position
+		rootPositionSource.push_back(column);
+		rootPositionTarget.push_back(channelId);
+		} // root position
+	} // AddChannel()
+
+// empty the skeleton
+void Skeleton::Clear()
+	{ // Clear()
+	parent.clear();
+	offset.clear();
+	firstChannel.clear();
+	channelCount.clear();
+	channels.clear();
+	nameId.clear();
+	rotationSource.clear();
+	rotationTarget.clear();
+	rootPositionSource.clear();
+	rootPositionTarget.clear();
+	rotationOrder.clear();
+	eulerConverter.clear();
+	kernels = &GenericPoseKernels();
+	} // Clear()
+
+// decode a frame of channel values into a rotation per joint and the root position
+void Skeleton::DecodeFrame(const float *frame, Cartesian3 *rotations, Cartesian3 &rootPosition) const
+	{ // DecodeFrame()
+	float *rotationValues = (float *) rotations;
+	memset(rotationValues, 0, JointCount() * sizeof(Cartesian3));
+	size_t rotationChannels = rotationSource.size();
+	const int *source = rotationSource.data();
+	const int *target = rotationTarget.data();
+	for (size_t entry = 0; entry < rotationChannels; entry++)
+		rotationValues[target[entry]] = frame[source[entry]];
+
+	float *positionValues = (float *) &rootPosition;
+	memset(positionValues, 0, sizeof(Cartesian3));
+	for (size_t entry = 0; entry < rootPositionSource.size(); entry++)
+		positionValues[rootPositionTarget[entry]] = frame[rootPositionSource[entry]];
+	} // DecodeFrame()
+
+// convert frames of decoded rotations to unit quaternions
+void Skeleton::ConvertRotations(const Cartesian3 *rotations, Quaternion *quaternions, size_t frames) const
+	{ // ConvertRotations()
+	size_t jointCount = JointCount();
+	for (size_t frame = 0; frame < frames; frame++)
+		for (size_t joint = 0; joint < jointCount; joint++)
+			{ // per joint
+			size_t index = frame * jointCount + joint;
+			EulerConverter converter = eulerConverter[joint];
+			quaternions[index] = converter != nullptr ? converter(rotations[index])
+				: Quaternion::Euler(rotations[index], &rotationOrder[3 * joint]);
+			// keep each joint in the same hemisphere as on the frame before, so that
+			// interpolating between neighbouring frames never takes the long way round
+			if (frame > 0 && quaternions[index].dot(quaternions[index - jointCount]) < 0.0f)
+				quaternions[index] = -quaternions[index];
+			} // per joint
+	} // ConvertRotations()
+
+// true if two skeletons have the same joints, hierarchy and channel layout
+bool Skeleton::SameLayout(const Skeleton &other) const
+	{ // SameLayout()
+	return parent == other.parent && nameId == other.nameId
+		&& channelCount == other.channelCount && channels == other.channels;
+	} // SameLayout()
+
+// intern a joint name
+int Skeleton::InternName(const std::string &name)
+	{ // InternName()
+	std::lock_guard<std::mutex> guard(internLock);
+	std::unordered_map<std::string, int>::iterator found = internedIds.find(name);
+	if (found != internedIds.end())
+		return found->second;
+	int id = (int) internedNames.size();
+	internedNames.push_back(name);
+	internedIds[name] = id;
+	return id;
+	} // InternName()
+
+// the name behind an interned id
+const std::string &Skeleton::InternedName(int id)
+	{ // InternedName()
+	std::lock_guard<std::mutex> guard(internLock);
+	return internedNames[id];
+	} // InternedName()
+
+// an empty chain
+JointChain::JointChain()
+	{ // constructor
+	} // constructor
+
+// the chain of some joints of a skeleton
+JointChain::JointChain(const Skeleton &skeleton, const std::vector<int> &targets)
+	: mask(skeleton.JointCount(), 0)
+	{ // constructor
+	// walk up from each joint until reaching one already in the chain
+	for (int target : targets)
+		for (int joint = target; joint >= 0 && joint < skeleton.JointCount() && !mask[joint]; joint = skeleton.parent[joint])
+			mask[joint] = 1;
+	for (int joint = 0; joint < skeleton.JointCount(); joint++)
+		if (mask[joint])
+			joints.push_back(joint);
+	} // constructor
+
+// whether a joint is in the chain
+bool JointChain::Contains(int joint) const
+	{ // Contains()
+	return joint >= 0 && joint < (int) mask.size() && mask[joint];
+	} // Contains()
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	Skeleton.h
+//	------------------------
+//	
+//	A flat skeleton stored as parallel arrays, one entry
+//	per joint in depth-first order. Parents always come
+//	before their children, so forward kinematics is a
+//	single loop from the root to the leaves.
+//	
+///////////////////////////////////////////////////
+
+#ifndef _SKELETON_H
+#define _SKELETON_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Cartesian3.h"
+#include "Quaternion.h"
+#include "PoseKernels.h"
+
+class Skeleton
+	{ // class Skeleton
+	public:
+	// index of each joint's parent, -1 for the root
+	std::vector<int> parent;
+
+	// offset of each joint from its parent
+	std::vector<Cartesian3> offset;
+
+	// the column of each joint's first channel in a frame, and its number of channels
+	std::vector<int> firstChannel;
+	std::vector<int> channelCount;
+
+	// the channel id of every column of a frame (as in BVHData::BVH_CHANNEL)
+	std::vector<int> channels;
+
+	// interned name of each joint
+	std::vector<int> nameId;
+
+	// the frame decode table, compiled as the channels are added: entry i copies
+	// column rotationSource[i] of a frame to float rotationTarget[i] of the decoded
+	// rotations (3 per joint, x y z), and likewise for the root's position channels
+	std::vector<int> rotationSource;
+	std::vector<int> rotationTarget;
+	std::vector<int> rootPositionSource;
+	std::vector<int> rootPositionTarget;
+
+	// the axes (0 to 2) of each joint's rotation channels in the order the file
+	// lists them, 3 per joint, -1 where a joint has fewer than three
+	std::vector<int> rotationOrder;
+
+	// the conversion to a quaternion compiled for each joint's rotation order, chosen
+	// as its channels are added (nullptr for an order with no version of its own)
+	std::vector<EulerConverter> eulerConverter;
+
+	// the forward kinematics and blend kernels for the number of joints, chosen as
+	// joints are added: fixed-length ones for a rig they were compiled for, else generic
+	const PoseKernels *kernels = &GenericPoseKernels();
+
+	// number of joints
+	int JointCount() const;
+
+	// number of floats in each frame
+	int ChannelCount() const;
+
+	// name of a joint
+	const std::string &Name(int joint) const;
+
+	// index of the joint with a given name, or -1
+	int FindJoint(const std::string &name) const;
+
+	// index of the first joint whose name holds a piece of text (e.g. "LeftFoot" in
+	// "mixamorig:LeftFoot"), or -1
+	int FindJointContaining(std::string_view text) const;
+
+	// add a joint below a given parent (which must already exist); returns its index
+	int AddJoint(const std::string &name, int parentJoint);
+
+	// add a channel to the most recently added joint
+	void AddChannel(int channelId);
+
+	// empty the skeleton
+	void Clear();
+
+	// decode a frame of channel values into a rotation per joint and the root position
+	// (a straight gather through the decode table; channels a joint lacks are zero)
+	void DecodeFrame(const float *frame, Cartesian3 *rotations, Cartesian3 &rootPosition) const;
+
+	// convert frames of decoded rotations (Euler angles in degrees, frame-major with one
+	// per joint) to unit quaternions, composing each joint's axes in its channel order
+	void ConvertRotations(const Cartesian3 *rotations, Quaternion *quaternions, size_t frames) const;
+
+	// true if two skeletons have the same joints, hierarchy and channel layout
+	// (offsets may differ, as they do between captures of the same rig)
+	bool SameLayout(const Skeleton &other) const;
+
+	// process-wide table of joint names, so names compare as integers
+	// safe to call from loader threads
+	static int InternName(const std::string &name);
+	static const std::string &InternedName(int id);
+	}; // class Skeleton
+
+// the joints needed to place a few joints of a skeleton: those joints and every one of
+// their ancestors, worked out once so that only these have to be evaluated (e.g. the
+// root for standing on the terrain, or the feet for contacts)
+class JointChain
+	{ // class JointChain
+	public:
+	// one flag per joint of the skeleton, set for the joints in the chain
+	std::vector<unsigned char> mask;
+
+	// the same joints as a list, in index order so that parents come before children
+	std::vector<int> joints;
+
+	// an empty chain
+	JointChain();
+
+	// the chain of some joints of a skeleton (joints out of range are ignored)
+	JointChain(const Skeleton &skeleton, const std::vector<int> &targets);
+
+	// whether a joint is in the chain
+	bool Contains(int joint) const;
+	}; // class JointChain
+
+#endif
@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	TransitionTable.cpp
+//	------------------------
+//
+//	The best frame to enter each clip at from every frame
+//	of every other, worked out once when the clips load.
+//	Each frame is described by where its joints are
+//	relative to the root (turned to face the way the root
+//	faces) and where they will be a moment later, and the
+//	entry into a clip is its frame nearest to the frame
+//	being left. The distances are taken on a pool of
+//	threads with SIMD kernels, and only the best entry of
+//	each is kept, so looking one up is a single index.
+//
+///////////////////////////////////////////////////
+
+#include "TransitionTable.h"
+#include "AlignedBuffer.h"
+#include "Pose.h"
+#include "PoseKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <thread>
+
+// a tenth of a second is about a third of a stride
+const float TransitionTable::lookAheadSeconds = 0.1f;
+
+// rows claimed by a worker at a time
+static const int rowsPerClaim = 16;
+
+// the most frames of a clip an entry can name
+static const int maxEntryFrames = std::numeric_limits<uint16_t>::max() + 1;
+
+// one clip's frames as feature vectors: each joint's position relative to the root, then
+// where it will be lookAheadSeconds on (looping round), both turned to face the way the
+// root faces; each vector is padded to a multiple of four floats
+static void ClipFeatures(const BVHData &clip, AlignedBuffer<float> &features, int stride)
+	{ // ClipFeatures()
+	int jointCount = clip.skeleton.JointCount();
+	features.Resize((size_t) clip.frame_count * stride);
+	// every frame's positions first, so that each can look ahead to the next
+	std::vector<Cartesian3> positions((size_t) clip.frame_count * jointCount);
+	Pose pose;
+	for (int frame = 0; frame < clip.frame_count; frame++)
+		{ // per frame
+		EvaluateFrame(clip, frame, pose);
+		Matrix4 facing = Matrix4::RotateY(-clip.RootHeading(clip.FrameQuaternions(frame)));
+		for (int joint = 0; joint < jointCount; joint++)
+			positions[(size_t) frame * jointCount + joint] = facing * pose.Position(joint);
+		} // per frame
+	float framesAhead = clip.frame_time > 0.0f ? TransitionTable::lookAheadSeconds / clip.frame_time : 0.0f;
+	for (int frame = 0; frame < clip.frame_count; frame++)
+		{ // per frame
+		float *vector = features.Data() + (size_t) frame * stride;
+		const Cartesian3 *now = &positions[(size_t) frame * jointCount];
+		const Cartesian3 *next = &positions[(size_t) ((frame + 1) % clip.frame_count) * jointCount];
+		for (int joint = 0; joint < jointCount; joint++)
+			{ // per joint
+			Cartesian3 ahead = now[joint] + (next[joint] - now[joint]) * framesAhead;
+			for (int axis = 0; axis < 3; axis++)
+				{ // per axis
+				vector[joint * 3 + axis] = now[joint][axis];
+				vector[(jointCount + joint) * 3 + axis] = ahead[axis];
+				} // per axis
+			} // per joint
+		} // per frame
+	} // ClipFeatures()
+
+// run a job for each of a number of items on a pool of threads (the calling thread
+// among them), each claiming a block of items at a time
+static void ForEachBlock(int itemCount, int blockSize, unsigned threadCount, const std::function<void(int first, int last)> &job)
+	{ // ForEachBlock()
+	std::atomic<int> nextItem(0);
+	auto worker = [&]()
+		{ // worker
+		for (int first = nextItem.fetch_add(blockSize); first < itemCount; first = nextItem.fetch_add(blockSize))
+			job(first, std::min(itemCount, first + blockSize));
+		}; // worker
+	std::vector<std::thread> pool;
+	for (unsigned thread = 1; thread < threadCount; thread++)
+		pool.emplace_back(worker);
+	worker();
+	for (std::thread &thread : pool)
+		thread.join();
+	} // ForEachBlock()
+
+// find the best entries between every pair of clips
+void TransitionTable::Build(const std::vector<ClipHandle> &newClips, unsigned threadCount)
+	{ // Build()
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	clips = newClips;
+	clipIndex.clear();
+	firstRow.assign(clips.size() + 1, 0);
+	for (size_t clip = 0; clip < clips.size(); clip++)
+		{ // per clip
+		clipIndex[clips[clip].get()] = (int) clip;
+		firstRow[clip + 1] = firstRow[clip] + clips[clip]->frame_count;
+		} // per clip
+	int clipCount = (int) clips.size();
+	int rowCount = firstRow.back();
+	entries.assign((size_t) rowCount * clipCount, 0);
+	if (clipCount == 0)
+		return;
+
+	// describe every frame, a clip to a worker (room is left for the most joints, though
+	// clips of different layouts have nothing useful to compare)
+	int jointCount = 0;
+	for (const ClipHandle &clip : clips)
+		jointCount = std::max(jointCount, clip->skeleton.JointCount());
+	int stride = (jointCount * 6 + 3) & ~3;
+	std::vector<AlignedBuffer<float>> features(clipCount);
+	ForEachBlock(clipCount, 1, std::min<unsigned>(threadCount, clipCount), [&](int first, int last)
+		{ // describe
+		for (int clip = first; clip < last; clip++)
+			ClipFeatures(*clips[clip], features[clip], stride);
+		}); // describe
+
+	// then compare each frame with every frame of every clip, keeping only the nearest;
+	// a row is written only by the worker that claimed it
+	ForEachBlock(rowCount, rowsPerClaim, threadCount, [&](int first, int last)
+		{ // compare
+		int from = (int) (std::upper_bound(firstRow.begin(), firstRow.end(), first) - firstRow.begin()) - 1;
+		for (int row = first; row < last; row++)
+			{ // per row
+			while (row >= firstRow[from + 1])
+				from++;
+			const float *source = features[from].Data() + (size_t) (row - firstRow[from]) * stride;
+			for (int to = 0; to < clipCount; to++)
+				{ // per target clip
+				int frames = std::min(clips[to]->frame_count, maxEntryFrames);
+				const float *target = features[to].Data();
+				int best = 0;
+				float bestDistance = std::numeric_limits<float>::max();
+				for (int frame = 0; frame < frames; frame++, target += stride)
+					{ // per target frame
+					float distance = SquaredDistance(source, target, stride);
+					if (distance < bestDistance)
+						{ // nearer
+						bestDistance = distance;
+						best = frame;
+						} // nearer
+					} // per target frame
+				entries[(size_t) row * clipCount + to] = (uint16_t) best;
+				} // per target clip
+			} // per row
+		}); // compare
+
+	buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	threadsUsed = threadCount;
+	} // Build()
+
+// the frame of a clip to enter at from a frame of another
+int TransitionTable::BestEntry(const BVHData &from, int frame, const BVHData &to) const
+	{ // BestEntry()
+	std::unordered_map<const BVHData *, int>::const_iterator source = clipIndex.find(&from);
+	std::unordered_map<const BVHData *, int>::const_iterator target = clipIndex.find(&to);
+	if (source == clipIndex.end() || target == clipIndex.end() || frame < 0 || frame >= from.frame_count)
+		return 0;
+	return entries[(size_t) (firstRow[source->second] + frame) * clips.size() + target->second];
+	} // BestEntry()
+
+// the number of clips in the table
+int TransitionTable::ClipCount() const
+	{ // ClipCount()
+	return (int) clips.size();
+	} // ClipCount()
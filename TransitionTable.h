@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////
+//
+//	------------------------
+//	TransitionTable.h
+//	------------------------
+//
+//	The best frame to enter each clip at from every frame
+//	of every other, worked out once when the clips load.
+//	Each frame is described by where its joints are
+//	relative to the root (turned to face the way the root
+//	faces) and where they will be a moment later, and the
+//	entry into a clip is its frame nearest to the frame
+//	being left. The distances are taken on a pool of
+//	threads with SIMD kernels, and only the best entry of
+//	each is kept, so looking one up is a single index.
+//
+///////////////////////////////////////////////////
+
+#ifndef _TRANSITIONTABLE_H
+#define _TRANSITIONTABLE_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "BVHData.h"
+
+class TransitionTable
+	{ // class TransitionTable
+	public:
+	// the seconds ahead that each joint's velocity is measured over, which weighs how
+	// a frame moves against how it stands
+	static const float lookAheadSeconds;
+
+	// find the best entries between every pair of clips (which must share a skeleton
+	// layout and be held in memory or mapped), on a number of threads (0 means one per
+	// core); entries past frame 65535 of a clip are never chosen
+	void Build(const std::vector<ClipHandle> &clips, unsigned threadCount = 0);
+
+	// the frame of a clip to enter at from a frame of another (0 if either clip was not
+	// in the table)
+	int BestEntry(const BVHData &from, int frame, const BVHData &to) const;
+
+	// the number of clips in the table
+	int ClipCount() const;
+
+	// the wall time of the last build and the threads it used
+	double buildSeconds = 0.0;
+	unsigned threadsUsed = 0;
+
+	private:
+	// the clips, and each one's index
+	std::vector<ClipHandle> clips;
+	std::unordered_map<const BVHData *, int> clipIndex;
+
+	// each clip's first row: a row per frame of every clip, one after the other
+	std::vector<int> firstRow;
+
+	// a row's best entry into each clip, row after row
+	std::vector<uint16_t> entries;
+	}; // class TransitionTable
+
+#endif
@@ -12,11 +12,17 @@
 #include <QtWidgets/QApplication>
 #include "SceneModel.h"
 #include "AnimationCycleWidget.h"
+#include "AnimationTools.h"
 #include <iostream>
 #include <string>
 
 int main(int argc, char **argv)
 	{ // main()
+	// command-line tools run headless, before any window exists
+	int toolResult = RunAnimationTool(argc, argv);
+	if (toolResult >= 0)
+		return toolResult;
+
 	// initialize QT
 	QApplication app(argc, argv);
 